@@ -0,0 +1,125 @@
+#include "BitPlanePacker.h"
+#include <cstdio>
+#include <cstdlib>
+
+BitPlanePacker::BitPlanePacker()
+    : enabled_(false), subframes_(1), fbo_(0), output_fbo_(0), color_texture_(0),
+      depth_buffer_(0), program_(0), vao_(0), bit_planes_location_(-1),
+      weight_location_(-1) {
+}
+
+BitPlanePacker::~BitPlanePacker() {
+}
+
+void BitPlanePacker::init(GLuint program, int width, int height, int subframes) {
+    if (subframes != 3 && subframes != 24) {
+        fprintf(stderr, "bit-plane packing needs 3 or 24 subframes, not %d\n", subframes);
+        exit(EXIT_FAILURE);
+    }
+    subframes_ = subframes;
+
+    glGenTextures(1, &color_texture_);
+    glBindTexture(GL_TEXTURE_2D, color_texture_);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0,
+                 GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glGenRenderbuffers(1, &depth_buffer_);
+    glBindRenderbuffer(GL_RENDERBUFFER, depth_buffer_);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    glGenFramebuffers(1, &fbo_);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo_);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                           GL_TEXTURE_2D, color_texture_, 0);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
+                              GL_RENDERBUFFER, depth_buffer_);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        fprintf(stderr, "bit-plane framebuffer is incomplete\n");
+        exit(EXIT_FAILURE);
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    program_ = program;
+    glProgramUniform1i(program_, glGetUniformLocation(program_, "subframe"), 0);
+    bit_planes_location_ = glGetUniformLocation(program_, "bit_planes");
+    weight_location_ = glGetUniformLocation(program_, "weight");
+    glProgramUniform1i(program_, bit_planes_location_, subframes == 24);
+
+    glGenVertexArrays(1, &vao_);
+    enabled_ = true;
+}
+
+void BitPlanePacker::setOutput(GLuint framebuffer) {
+    output_fbo_ = framebuffer;
+}
+
+bool BitPlanePacker::enabled() const {
+    return enabled_;
+}
+
+int BitPlanePacker::subframes() const {
+    return subframes_;
+}
+
+GLuint BitPlanePacker::framebuffer() const {
+    return fbo_;
+}
+
+void BitPlanePacker::beginSubframe(int k) {
+    if (enabled_) {
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo_);
+    }
+}
+
+void BitPlanePacker::endSubframe(int k) {
+    if (!enabled_) {
+        return;
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, output_fbo_);
+    glDisable(GL_DEPTH_TEST);
+    if (k == 0) {
+        glClearColor(0, 0, 0, 1);
+        glClear(GL_COLOR_BUFFER_BIT);
+    }
+
+    int channel = (subframes_ == 24) ? k / 8 : k;
+    glColorMask(channel == 0, channel == 1, channel == 2, GL_FALSE);
+    if (subframes_ == 24) {
+        // bits of a channel are summed; exact, as every bit is a
+        // whole step of the 8-bit channel
+        glProgramUniform1f(program_, weight_location_, (1 << (k % 8)) / 255.0f);
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_ONE, GL_ONE);
+    }
+
+    glBindTexture(GL_TEXTURE_2D, color_texture_);
+    glUseProgram(program_);
+    glBindVertexArray(vao_);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    glBindVertexArray(0);
+
+    glDisable(GL_BLEND);
+    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+    glEnable(GL_DEPTH_TEST);
+}
+
+int BitPlanePacker::unpack(const uint8_t* rgba, int subframes, int k) {
+    if (subframes == 24) {
+        return (rgba[k / 8] >> (k % 8)) & 1 ? 255 : 0;
+    }
+    return rgba[k];
+}
+
+int BitPlanePacker::quantize(const uint8_t* rgba, int subframes) {
+    int v = rgba[0];
+    v = (rgba[1] > v) ? rgba[1] : v;
+    v = (rgba[2] > v) ? rgba[2] : v;
+    if (subframes == 24) {
+        return (v >= 128) ? 255 : 0;
+    }
+    return v;
+}
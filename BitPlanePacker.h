@@ -0,0 +1,61 @@
+#ifndef BIT_PLANE_PACKER_H
+#define BIT_PLANE_PACKER_H
+
+#include <GL/glew.h>
+#include <stdint.h>
+
+/* Packs several monochrome subframes into one output frame for DLP
+ projectors in structured-light mode, which show each color channel,
+ or each bit of each channel, as its own subframe.
+
+ With 3 subframes, subframe k becomes channel k (red, green, blue) at
+ 8 bits. With 24, subframe k becomes bit k % 8 of channel k / 8, so a
+ 60 Hz frame carries 1440 Hz of binary stimulus. Projectors differ in
+ the order they show planes in; this is the order of the DLPC
+ pattern sequence with red first, least significant bit first.
+
+ Each subframe is drawn into our framebuffer between beginSubframe()
+ and endSubframe() (or, with a WarpPass, warped into it), then reduced
+ to its brightest channel and written into its plane of the output
+ with glColorMask, with additive blending to sum bit planes.
+ */
+class BitPlanePacker
+{
+public:
+    BitPlanePacker();
+    ~BitPlanePacker();
+
+    // needs a current GL context. program is built from warp.vert and
+    // bitplane.frag; subframes is 3 or 24
+    void init(GLuint program, int width, int height, int subframes);
+    void setOutput(GLuint framebuffer); // default framebuffer unless set
+
+    bool enabled() const;
+    int subframes() const; // 1 when disabled
+    GLuint framebuffer() const; // where subframes are drawn
+
+    void beginSubframe(int k);
+    void endSubframe(int k);
+
+    // what subframe k of a packed RGBA pixel shows, 0-255, and what a
+    // rendered RGBA pixel should pack to, for checking the round trip
+    static int unpack(const uint8_t* rgba, int subframes, int k);
+    static int quantize(const uint8_t* rgba, int subframes);
+
+private:
+    bool enabled_;
+    int subframes_;
+    GLuint fbo_;
+    GLuint output_fbo_;
+    GLuint color_texture_;
+    GLuint depth_buffer_;
+    GLuint program_;
+    GLuint vao_;
+    GLint bit_planes_location_;
+    GLint weight_location_;
+
+    BitPlanePacker(const BitPlanePacker&);
+    BitPlanePacker& operator=(const BitPlanePacker&);
+};
+
+#endif
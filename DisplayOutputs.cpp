@@ -0,0 +1,307 @@
+#include "DisplayOutputs.h"
+#include "Latency.h"
+#define GLFW_EXPOSE_NATIVE_X11
+#define GLFW_EXPOSE_NATIVE_GLX
+#include <GLFW/glfw3native.h>
+#include <cmath>
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+
+// visual angle covered by the panorama, split between the outputs
+#define PANORAMA_DEG 200.0
+
+DisplayOutputs::DisplayOutputs()
+    : enabled_(false), half_width_(1), refresh_period_(1.0 / 60), width_(0), height_(0),
+      viewport_x_(0), viewport_width_(0), fbo_(0), color_texture_(0), depth_buffer_(0),
+      program_(0), display_(NULL), get_sync_values_(NULL), frames_(0), incoherent_(0) {
+}
+
+DisplayOutputs::~DisplayOutputs() {
+}
+
+bool DisplayOutputs::init(GLFWwindow* primary, int count, GLuint program, float half_width,
+                          double refresh_period) {
+    int monitors = 0;
+    GLFWmonitor** monitor = glfwGetMonitors(&monitors);
+    if (count < 2 || monitors < count) {
+        fprintf(stderr, "%d outputs requested but %d monitors connected\n",
+                count, monitors);
+        return false;
+    }
+    half_width_ = half_width;
+    refresh_period_ = refresh_period;
+    program_ = program;
+
+    // output 0 is the primary window, drawn on monitor 0, and the rest
+    // get a fullscreen window on the next monitors in order
+    outputs_.resize(count);
+    for (int i = 0; i < count; ++i) {
+        Output& out = outputs_[i];
+        out.window = primary;
+        out.lut_texture = 0;
+        out.vao = 0;
+        out.drawable = 0;
+        out.swaps = 0;
+        out.msc = 0;
+        if (i > 0) {
+            const GLFWvidmode* mode = glfwGetVideoMode(monitor[i]);
+            out.window = glfwCreateWindow(mode->width, mode->height, "stimulus",
+                                          monitor[i], primary);
+            if (!out.window) {
+                fprintf(stderr, "could not open a window on monitor %d\n", i);
+                outputs_.resize(i);
+                destroy();
+                return false;
+            }
+            glfwMakeContextCurrent(out.window);
+            glfwSwapInterval(0); // the primary window paces the loop
+            glGenVertexArrays(1, &out.vao);
+            glfwMakeContextCurrent(primary);
+        } else {
+            glGenVertexArrays(1, &out.vao);
+        }
+        glfwGetFramebufferSize(out.window, &out.width, &out.height);
+        GLXDrawable drawable = glfwGetGLXWindow(out.window);
+        out.drawable = drawable ? drawable : glfwGetX11Window(out.window);
+        width_ += out.width;
+        height_ = (out.height > height_) ? out.height : height_;
+    }
+
+    // the scene spans [-half_width, half_width] in x, so a viewport
+    // 1 / half_width times the panorama's width puts it edge to edge
+    GLint max_viewport[2];
+    glGetIntegerv(GL_MAX_VIEWPORT_DIMS, max_viewport);
+    viewport_width_ = (int)ceil(width_ / half_width_);
+    if (viewport_width_ > max_viewport[0]) {
+        printf("panorama needs a %d pixel viewport, clamped to %d\n",
+               viewport_width_, max_viewport[0]);
+        viewport_width_ = max_viewport[0];
+    }
+    viewport_x_ = (width_ - viewport_width_) / 2;
+
+    glGenTextures(1, &color_texture_);
+    glBindTexture(GL_TEXTURE_2D, color_texture_);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width_, height_, 0,
+                 GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    glGenRenderbuffers(1, &depth_buffer_);
+    glBindRenderbuffer(GL_RENDERBUFFER, depth_buffer_);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width_, height_);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    glGenFramebuffers(1, &fbo_);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo_);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                           GL_TEXTURE_2D, color_texture_, 0);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
+                              GL_RENDERBUFFER, depth_buffer_);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        fprintf(stderr, "panorama framebuffer is incomplete\n");
+        exit(EXIT_FAILURE);
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    // textures are shared between the contexts
+    for (int i = 0; i < count; ++i) {
+        glGenTextures(1, &outputs_[i].lut_texture);
+        glBindTexture(GL_TEXTURE_2D, outputs_[i].lut_texture);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glBindTexture(GL_TEXTURE_2D, 0);
+
+        std::vector<float> uv;
+        buildPanelLut(i, uv);
+        setLut(i, uv);
+    }
+
+    glProgramUniform1i(program_, glGetUniformLocation(program_, "scene"), 0);
+    glProgramUniform1i(program_, glGetUniformLocation(program_, "lut"), 1);
+
+    display_ = glfwGetX11Display();
+    const char* extensions = glXQueryExtensionsString(display_, DefaultScreen(display_));
+    if (extensions && strstr(extensions, "GLX_OML_sync_control")) {
+        get_sync_values_ = (GetSyncValuesProc)
+            glXGetProcAddressARB((const GLubyte*) "glXGetSyncValuesOML");
+    }
+    if (get_sync_values_) {
+        swapsLocked(); // the counters to compare the first frame against
+    } else {
+        printf("GLX_OML_sync_control not available, output coherence is "
+               "only checked from queue times\n");
+    }
+
+    printf("%d outputs, %d x %d panorama\n", count, width_, height_);
+    enabled_ = true;
+    return true;
+}
+
+void DisplayOutputs::destroy() {
+    GLFWwindow* primary = outputs_.empty() ? NULL : outputs_[0].window;
+    for (unsigned int i = 1; i < outputs_.size(); ++i) {
+        glfwMakeContextCurrent(outputs_[i].window);
+        glDeleteVertexArrays(1, &outputs_[i].vao);
+        glfwMakeContextCurrent(primary);
+        glfwDestroyWindow(outputs_[i].window);
+    }
+    outputs_.clear();
+    enabled_ = false;
+}
+
+void DisplayOutputs::buildPanelLut(int output, std::vector<float>& uv) {
+    const Output& out = outputs_[output];
+    int n = outputs_.size();
+    double span = PANORAMA_DEG / n;
+    double center = -PANORAMA_DEG / 2 + (output + 0.5) * span;
+    double half_span = 0.5 * span * M_PI / 180;
+
+    // a flat panel facing the fish: equal steps across the screen are
+    // smaller steps in angle toward its edges, and a line of constant
+    // elevation bows toward the horizon off the panel's center
+    uv.resize(2 * out.width * out.height);
+    for (int j = 0; j < out.height; ++j) {
+        double t = (j + 0.5) / out.height;
+        for (int i = 0; i < out.width; ++i) {
+            double s = 2 * (i + 0.5) / out.width - 1;
+            double off_axis = atan(s * tan(half_span));
+            double angle = center + off_axis * 180 / M_PI;
+
+            // scene x in GL units, then into the panorama's viewport
+            double x = half_width_ * angle / (PANORAMA_DEG / 2);
+            double pixel = viewport_x_ + 0.5 * (x + 1) * viewport_width_;
+            float* p = &uv[2 * (j * out.width + i)];
+            p[0] = pixel / width_;
+            p[1] = 0.5 + (t - 0.5) * cos(off_axis) * out.height / height_;
+        }
+    }
+}
+
+void DisplayOutputs::setLut(int output, const std::vector<float>& uv) {
+    const Output& out = outputs_[output];
+    glBindTexture(GL_TEXTURE_2D, out.lut_texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RG32F, out.width, out.height, 0,
+                 GL_RG, GL_FLOAT, uv.data());
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+bool DisplayOutputs::enabled() const {
+    return enabled_;
+}
+
+int DisplayOutputs::outputs() const {
+    return outputs_.size();
+}
+
+GLFWwindow* DisplayOutputs::window(int output) {
+    return outputs_[output].window;
+}
+
+bool DisplayOutputs::shouldClose() {
+    for (unsigned int i = 0; i < outputs_.size(); ++i) {
+        if (glfwWindowShouldClose(outputs_[i].window)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void DisplayOutputs::begin() {
+    if (enabled_) {
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo_);
+        glViewport(viewport_x_, 0, viewport_width_, height_);
+    }
+}
+
+void DisplayOutputs::draw(Output& out) {
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(0, 0, out.width, out.height);
+    glDisable(GL_DEPTH_TEST);
+
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, color_texture_);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, out.lut_texture);
+    glActiveTexture(GL_TEXTURE0);
+
+    glUseProgram(program_);
+    glBindVertexArray(out.vao);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    glBindVertexArray(0);
+
+    glEnable(GL_DEPTH_TEST);
+}
+
+bool DisplayOutputs::swapsLocked() {
+    // every output should have shown the frame before this one, and
+    // seen as many refreshes since the last check as the primary
+    bool locked = true;
+    int64_t refreshes = -1;
+    for (unsigned int i = 0; i < outputs_.size(); ++i) {
+        Output& out = outputs_[i];
+        int64_t ust, msc, sbc;
+        if (!get_sync_values_(display_, out.drawable, &ust, &msc, &sbc)) {
+            locked = false;
+            continue;
+        }
+        locked = locked && (sbc >= out.swaps - 1);
+        if (refreshes < 0) {
+            refreshes = msc - out.msc;
+        }
+        locked = locked && (msc - out.msc == refreshes);
+        out.msc = msc;
+    }
+    return locked;
+}
+
+void DisplayOutputs::present() {
+    if (!enabled_) {
+        return;
+    }
+    GLFWwindow* primary = outputs_[0].window;
+    double start = monotonicTime();
+
+    // the other contexts only see the finished panorama once this
+    // fence has been flushed to the GPU
+    GLsync drawn = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    glFlush();
+
+    for (unsigned int i = 1; i < outputs_.size(); ++i) {
+        glfwMakeContextCurrent(outputs_[i].window);
+        glWaitSync(drawn, 0, GL_TIMEOUT_IGNORED);
+        draw(outputs_[i]);
+        glfwSwapBuffers(outputs_[i].window);
+        outputs_[i].swaps++;
+    }
+    glfwMakeContextCurrent(primary);
+    glDeleteSync(drawn);
+    double queued = monotonicTime() - start;
+
+    // last, so waiting for vsync here leaves every other output
+    // already queued for the same refresh
+    draw(outputs_[0]);
+    glfwSwapBuffers(primary);
+    outputs_[0].swaps++;
+
+    // the other outputs have to be queued well inside the refresh the
+    // primary is about to wait for
+    bool coherent = (queued < 0.5 * refresh_period_);
+    if (get_sync_values_) {
+        coherent = swapsLocked() && coherent;
+    }
+    if (!coherent) {
+        incoherent_++;
+    }
+    frames_++;
+}
+
+unsigned long long DisplayOutputs::frames() const {
+    return frames_;
+}
+
+unsigned long long DisplayOutputs::incoherent() const {
+    return incoherent_;
+}
@@ -0,0 +1,107 @@
+#ifndef DISPLAY_OUTPUTS_H
+#define DISPLAY_OUTPUTS_H
+
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include <X11/Xlib.h>
+#include <GL/glx.h>
+#include <stdint.h>
+#include <vector>
+
+/* Drives several monitors or projectors from one update step.
+
+ The stimulus is drawn once, with the flat shaders, into a panorama
+ framebuffer whose x axis is linear in visual angle across the full
+ SCREEN_WIDTH_DEG. Each output then has its own fullscreen window and
+ lookup table, like WarpPass, mapping its pixels to the part of the
+ panorama it shows. By default outputs split the panorama into equal
+ spans and are modelled as flat panels facing the fish; a measured
+ calibration can replace any table through setLut().
+
+ Extra windows share the primary window's GL context, so meshes,
+ programs and the panorama itself are uploaded and compiled once. A
+ fence set after the panorama is drawn makes every output wait for the
+ same frame. Only the primary window waits for vsync; the others swap
+ just before it, so on frame-locked displays every output shows the
+ frame in the same refresh.
+
+ A frame is counted as incoherent if queuing the other outputs took
+ longer than half a refresh period. With GLX_OML_sync_control each
+ output's swap and refresh counters are also read after every frame:
+ it is incoherent too if an output hasn't completed the swap it was
+ given the frame before, or if the outputs saw different numbers of
+ refreshes since then. Without the extension only the queue time is
+ checked.
+ */
+class DisplayOutputs
+{
+public:
+    DisplayOutputs();
+    ~DisplayOutputs();
+
+    // with the primary window's context current. program is built
+    // from warp.vert and warp.frag; half_width is the screen's half
+    // width in GL units. false if there are fewer than count monitors
+    bool init(GLFWwindow* primary, int count, GLuint program, float half_width,
+              double refresh_period);
+    void destroy();
+
+    bool enabled() const;
+    int outputs() const;
+    GLFWwindow* window(int output);
+    bool shouldClose();
+
+    // per output pixel (u, v) in the panorama, -1 where nothing belongs
+    void setLut(int output, const std::vector<float>& uv);
+
+    void begin(); // draw the stimulus after this
+    void present(); // warps and swaps every output
+
+    unsigned long long frames() const;
+    unsigned long long incoherent() const;
+
+private:
+    typedef struct Output {
+        GLFWwindow* window;
+        int width;
+        int height;
+        GLuint lut_texture;
+        GLuint vao;       // per context, VAOs aren't shared
+        GLXDrawable drawable;
+        int64_t swaps;    // issued
+        int64_t msc;      // refresh count when last checked
+    } Output;
+
+    typedef Bool (*GetSyncValuesProc)(Display*, GLXDrawable, int64_t*, int64_t*, int64_t*);
+
+    void buildPanelLut(int output, std::vector<float>& uv);
+    void draw(Output& output);
+    bool swapsLocked(); // from the outputs' OML counters
+
+    bool enabled_;
+    std::vector<Output> outputs_;
+    float half_width_;
+    double refresh_period_;
+
+    // panorama, drawn through a viewport that stretches the scene's
+    // [-half_width, half_width] across the whole framebuffer
+    int width_;
+    int height_;
+    int viewport_x_;
+    int viewport_width_;
+    GLuint fbo_;
+    GLuint color_texture_;
+    GLuint depth_buffer_;
+    GLuint program_;
+
+    Display* display_;
+    GetSyncValuesProc get_sync_values_; // NULL without GLX_OML_sync_control
+
+    unsigned long long frames_;
+    unsigned long long incoherent_;
+
+    DisplayOutputs(const DisplayOutputs&);
+    DisplayOutputs& operator=(const DisplayOutputs&);
+};
+
+#endif
@@ -0,0 +1,86 @@
+#include "FrameDecoder.h"
+
+FrameDecoder::FrameDecoder(uint8_t flag)
+    : flag_(flag), frames_(0), malformed_(0), discarded_(0) {
+    reset();
+}
+
+void FrameDecoder::reset() {
+    locked_ = false;
+    state_ = 0;
+    data0_ = 0;
+    run_[0] = run_[1] = run_[2] = 0;
+    phase_ = 0;
+}
+
+bool FrameDecoder::locked() const {
+    return locked_;
+}
+
+unsigned long FrameDecoder::frames() const {
+    return frames_;
+}
+
+unsigned long FrameDecoder::malformed() const {
+    return malformed_;
+}
+
+unsigned long FrameDecoder::discarded() const {
+    return discarded_;
+}
+
+size_t FrameDecoder::decode(const uint8_t* data, size_t n, RootSample* out) {
+    size_t m = 0;
+    for (size_t i = 0; i < n; ++i) {
+        uint8_t b = data[i];
+
+        if (!locked_) {
+            hunt(b);
+            continue;
+        }
+
+        switch (state_) {
+            case 0:
+                if (b == flag_) {
+                    state_ = 1;
+                } else {
+                    // lost the frame boundary, start looking for it again
+                    malformed_++;
+                    reset();
+                    hunt(b);
+                }
+                break;
+            case 1:
+                data0_ = b;
+                state_ = 2;
+                break;
+            case 2:
+                out[m].data0 = data0_;
+                out[m].data1 = b;
+                m++;
+                frames_++;
+                state_ = 0;
+                break;
+        }
+    }
+    return m;
+}
+
+void FrameDecoder::hunt(uint8_t b) {
+    discarded_++;
+
+    run_[phase_] = (b == flag_) ? run_[phase_] + 1 : 0;
+
+    // lock on if this offset has enough flags in a row and the other
+    // two offsets are well short of it. a channel stuck at 255 keeps its
+    // offset's run growing with the flag's, one byte behind or ahead, so
+    // while it stays saturated neither offset can lock
+    if (run_[phase_] >= kLockFrames &&
+        run_[(phase_ + 1) % 3] < kLockFrames - 1 &&
+        run_[(phase_ + 2) % 3] < kLockFrames - 1) {
+        locked_ = true;
+        state_ = 1; // b was a flag, data0 comes next
+    }
+
+    phase_ = (phase_ + 1) % 3;
+}
@@ -0,0 +1,59 @@
+#ifndef FRAME_DECODER_H
+#define FRAME_DECODER_H
+
+#include <stdint.h>
+#include <cstddef>
+
+// one decoded frame from the arduino: a sample from each ventral root
+typedef struct RootSample {
+    uint8_t data0;
+    uint8_t data1;
+} RootSample;
+
+/* Streaming decoder for the [flag, data0, data1] frames sent by
+ ventralRootCodeV2_8bit. Partial frames are carried over between
+ calls to decode(), so reads can be split anywhere.
+
+ Because a sample can itself equal the flag value, a single flag byte
+ does not say where a frame starts. The decoder only locks on once it
+ has seen kLockFrames flags in a row at a 3-byte stride, and only if
+ neither other alignment comes close. A channel saturated at the flag
+ value therefore holds the decoder in the hunt until it drops below
+ 255 again. Once locked, a missing flag
+ counts as a malformed frame and the decoder goes back to hunting.
+ */
+class FrameDecoder
+{
+public:
+    FrameDecoder(uint8_t flag);
+
+    // decodes n bytes into out, which must have room for n / 3 + 1
+    // samples. returns the number of samples written.
+    size_t decode(const uint8_t* data, size_t n, RootSample* out);
+    void reset();
+
+    bool locked() const;
+    unsigned long frames() const;
+    unsigned long malformed() const;
+    unsigned long discarded() const;
+
+private:
+    static const int kLockFrames = 4;
+
+    void hunt(uint8_t b);
+
+    uint8_t flag_;
+    bool locked_;
+    int state_; // 0: expecting flag, 1: expecting data0, 2: expecting data1
+    uint8_t data0_;
+
+    // while hunting: how many flags in a row we've seen at each offset
+    int run_[3];
+    int phase_;
+
+    unsigned long frames_; // frames decoded
+    unsigned long malformed_; // frames whose flag byte was missing
+    unsigned long discarded_; // bytes thrown away while resynchronising
+};
+
+#endif
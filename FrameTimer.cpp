@@ -0,0 +1,229 @@
+#include "FrameTimer.h"
+#include "Latency.h"
+#include "RecordFile.h"
+#include <cstdio>
+#include <cmath>
+
+FrameTimer::FrameTimer(size_t capacity)
+    : frame_(0), refresh_period_(0), start_(0), update_start_(0),
+      update_total_(0), draw_start_(0), draw_end_(0), last_swap_(0), use_queries_(false),
+      curr_query_(-1), missed_(0), trials_done_(0) {
+    size_t n = 1;
+    while (n < capacity) {
+        n <<= 1;
+    }
+    records_ = new FrameRecord[n];
+    mask_ = n - 1;
+
+    // a trial is only kept if it had a frame, or a late frame skipped
+    // it, so this ring doesn't wrap before the frame ring does
+    trials_ = new TrialFrames[n];
+    for (int i = 0; i < kQueries; ++i) {
+        queries_[i] = 0;
+        query_frame_[i] = -1;
+    }
+    curr_trial_.trial = -1;
+    curr_trial_.frames = 0;
+    curr_trial_.missed = 0;
+    curr_trial_.worst_ms = 0;
+}
+
+FrameTimer::~FrameTimer() {
+    delete[] records_;
+    delete[] trials_;
+}
+
+void FrameTimer::init(double refresh_rate) {
+    refresh_period_ = (refresh_rate > 0) ? 1.0 / refresh_rate : 1.0 / 60;
+    use_queries_ = GLEW_ARB_timer_query;
+    if (use_queries_) {
+        glGenQueries(kQueries, queries_);
+    } else {
+        printf("GL_ARB_timer_query not available, no GPU frame times\n");
+    }
+}
+
+void FrameTimer::beginUpdate() {
+    update_start_ = monotonicTime();
+    if (start_ == 0) {
+        start_ = update_start_;
+        last_swap_ = update_start_;
+    }
+}
+
+void FrameTimer::endUpdate() {
+    update_total_ += monotonicTime() - update_start_;
+}
+
+void FrameTimer::beginDraw() {
+    draw_start_ = monotonicTime();
+
+    // use the next query unless it still hasn't come back
+    curr_query_ = -1;
+    int q = frame_ % kQueries;
+    if (use_queries_ && query_frame_[q] < 0) {
+        glBeginQuery(GL_TIME_ELAPSED, queries_[q]);
+        query_frame_[q] = frame_;
+        curr_query_ = q;
+    }
+}
+
+void FrameTimer::endDraw() {
+    if (curr_query_ >= 0) {
+        glEndQuery(GL_TIME_ELAPSED);
+    }
+    draw_end_ = monotonicTime();
+}
+
+void FrameTimer::resume() {
+    // the next swap starts a new interval, so the pause isn't counted
+    // as missed vsyncs
+    last_swap_ = 0;
+}
+
+void FrameTimer::swapped(int trial) {
+    // with vsync on, swap returns once the driver has a free back
+    // buffer, which paces it to the display after the first few frames
+    double now = monotonicTime();
+    double interval = (frame_ > 0 && last_swap_ > 0) ? now - last_swap_ : 0;
+    last_swap_ = now;
+
+    int missed = (int)floor(interval / refresh_period_ + 0.5) - 1;
+    missed = (missed > 0) ? missed : 0;
+
+    FrameRecord& r = records_[frame_ & mask_];
+    r.swap = now - start_;
+    r.update_ms = 1000 * update_total_;
+    update_total_ = 0;
+    r.draw_ms = 1000 * (draw_end_ - draw_start_);
+    r.gpu_ms = -1;
+    r.interval_ms = 1000 * interval;
+    r.trial = trial;
+    r.missed = missed;
+    frame_++;
+
+    if (trial != curr_trial_.trial) {
+        finishTrial();
+        curr_trial_.trial = trial;
+    }
+    if (trial >= 0) {
+        curr_trial_.frames++;
+        curr_trial_.missed += missed;
+        if (r.interval_ms > curr_trial_.worst_ms) {
+            curr_trial_.worst_ms = r.interval_ms;
+        }
+        missed_ += missed;
+    }
+
+    collectQueries(false);
+}
+
+void FrameTimer::lostTrial(int trial) {
+    // any trial still open ended before this one, keep them in order
+    finishTrial();
+    TrialFrames& t = trials_[trials_done_ & mask_];
+    t.trial = trial;
+    t.frames = 0;
+    t.missed = 0;
+    t.worst_ms = 0;
+    trials_done_++;
+}
+
+void FrameTimer::finishTrial() {
+    if (curr_trial_.trial >= 0 && curr_trial_.frames > 0) {
+        if (curr_trial_.missed > 0) {
+            printf("trial %d: %d missed vsyncs in %d frames, worst interval %.1f ms\n",
+                   curr_trial_.trial, curr_trial_.missed, curr_trial_.frames,
+                   curr_trial_.worst_ms);
+        }
+        trials_[trials_done_ & mask_] = curr_trial_;
+        trials_done_++;
+    }
+    curr_trial_.trial = -1;
+    curr_trial_.frames = 0;
+    curr_trial_.missed = 0;
+    curr_trial_.worst_ms = 0;
+}
+
+void FrameTimer::collectQueries(bool wait) {
+    for (int q = 0; q < kQueries; ++q) {
+        if (query_frame_[q] < 0) {
+            continue;
+        }
+        GLint available = 0;
+        if (!wait) {
+            glGetQueryObjectiv(queries_[q], GL_QUERY_RESULT_AVAILABLE, &available);
+        }
+        if (wait || available) {
+            GLuint64 ns = 0;
+            glGetQueryObjectui64v(queries_[q], GL_QUERY_RESULT, &ns);
+            unsigned long long f = query_frame_[q];
+            if (frame_ - f <= mask_) {
+                records_[f & mask_].gpu_ms = 1e-6 * ns;
+            }
+            query_frame_[q] = -1;
+        }
+    }
+}
+
+unsigned long long FrameTimer::frames() const {
+    return frame_;
+}
+
+int FrameTimer::missed() const {
+    return missed_;
+}
+
+bool FrameTimer::save(const char* path) {
+    if (use_queries_) {
+        collectQueries(true);
+    }
+    finishTrial();
+
+    unsigned long long first = (frame_ > mask_ + 1) ? frame_ - (mask_ + 1) : 0;
+    int n = frame_ - first;
+    if (first > 0) {
+        printf("frame timer kept the last %d of %llu frames\n", n, frame_);
+    }
+
+    RecordFile file(1 << 16);
+    int swap_ch = file.addChannel("swap", RECORD_FLOAT64, 0);
+    int draw_ch = file.addChannel("draw_ms", RECORD_FLOAT32, 0);
+    int update_ch = file.addChannel("update_ms", RECORD_FLOAT32, 0);
+    int gpu_ch = file.addChannel("gpu_ms", RECORD_FLOAT32, 0);
+    int interval_ch = file.addChannel("interval_ms", RECORD_FLOAT32, 0);
+    int trial_ch = file.addChannel("trial", RECORD_INT32, 0);
+    int missed_ch = file.addChannel("missed", RECORD_INT32, 0);
+
+    // one sample per trial
+    int trial_id_ch = file.addChannel("trial_id", RECORD_INT32, 0);
+    int trial_frames_ch = file.addChannel("trial_frames", RECORD_INT32, 0);
+    int trial_missed_ch = file.addChannel("trial_missed", RECORD_INT32, 0);
+    int trial_worst_ch = file.addChannel("trial_worst_ms", RECORD_FLOAT32, 0);
+
+    file.addParam("refresh_rate", 1 / refresh_period_);
+    file.addParam("first_frame", (double)first);
+
+    if (!file.open(path)) {
+        return false;
+    }
+    for (int i = 0; i < n; ++i) {
+        const FrameRecord& r = records_[(first + i) & mask_];
+        file.append(swap_ch, r.swap);
+        file.append(draw_ch, r.draw_ms);
+        file.append(update_ch, r.update_ms);
+        file.append(gpu_ch, r.gpu_ms);
+        file.append(interval_ch, r.interval_ms);
+        file.append(trial_ch, &r.trial, 1);
+        file.append(missed_ch, &r.missed, 1);
+    }
+    unsigned long long first_trial = (trials_done_ > mask_ + 1) ? trials_done_ - (mask_ + 1) : 0;
+    for (unsigned long long i = first_trial; i < trials_done_; ++i) {
+        const TrialFrames& t = trials_[i & mask_];
+        file.append(trial_id_ch, &t.trial, 1);
+        file.append(trial_frames_ch, &t.frames, 1);
+        file.append(trial_missed_ch, &t.missed, 1);
+        file.append(trial_worst_ch, t.worst_ms);
+    }
+    return file.close();
+}
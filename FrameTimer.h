@@ -0,0 +1,98 @@
+#ifndef FRAME_TIMER_H
+#define FRAME_TIMER_H
+
+#include <GL/glew.h>
+#include <stdint.h>
+#include <cstddef>
+
+// timing of one pass through the game loop, times in ms
+typedef struct FrameRecord {
+    double swap;        // seconds since the first frame
+    float update_ms;    // CPU time in the update function(s)
+    float draw_ms;      // CPU time submitting the draw calls
+    float gpu_ms;       // GPU time executing the draw calls, -1 if unknown
+    float interval_ms;  // time since the previous swap
+    int32_t trial;      // -1 outside of a trial
+    int32_t missed;     // vsyncs missed before this frame was shown
+} FrameRecord;
+
+// frame statistics for one trial
+typedef struct TrialFrames {
+    int32_t trial;
+    int32_t frames;
+    int32_t missed;
+    float worst_ms;
+} TrialFrames;
+
+/* Per-frame telemetry for the render loop. Call, in order, every frame:
+
+     beginUpdate(); update...; endUpdate(); beginDraw(); draw...; endDraw();
+     swap buffers; swapped(trial);
+
+ When bit-plane packing runs several updates per frame, the updates
+ are timed as a sum and the draw span is taken around all subframes,
+ updates included.
+
+ Records go into preallocated rings so the loop never allocates;
+ once they wrap, the oldest frames and trials are overwritten. GPU time comes
+ from GL_TIME_ELAPSED queries that are read back a few frames later,
+ so timing never stalls the pipeline.
+
+ A swap interval of n refresh periods means n - 1 vsyncs were missed
+ and the previous frame stayed on screen that much longer. Misses are
+ counted per trial and trials with any are reported. A trial a late
+ frame skipped entirely is kept with 0 frames. After a pause in the
+ loop, resume() keeps the first frame's interval from counting.
+ */
+class FrameTimer
+{
+public:
+    explicit FrameTimer(size_t capacity);
+    ~FrameTimer();
+
+    // needs a current GL context
+    void init(double refresh_rate);
+
+    void beginUpdate();
+    void endUpdate();
+    void beginDraw();
+    void endDraw();
+    void swapped(int trial);
+    void lostTrial(int trial); // its stimulus fell between two frames
+    void resume(); // after the loop stopped for a while, e.g. calibration
+
+    unsigned long long frames() const;
+    int missed() const; // over the whole session
+
+    // writes every frame still in the ring plus the per-trial table
+    bool save(const char* path);
+
+private:
+    void collectQueries(bool wait);
+    void finishTrial();
+
+    FrameRecord* records_;
+    size_t mask_;
+    unsigned long long frame_; // frames completed
+
+    double refresh_period_;
+    double start_;
+    double update_start_, update_total_, draw_start_, draw_end_, last_swap_;
+
+    // timer queries in flight, one per frame
+    static const int kQueries = 4;
+    bool use_queries_;
+    GLuint queries_[kQueries];
+    long long query_frame_[kQueries]; // -1 when the query is free
+    int curr_query_; // query running this frame, -1 if none
+
+    int missed_;
+    TrialFrames* trials_; // ring of finished and lost trials, same size as records_
+    unsigned long long trials_done_;
+    TrialFrames curr_trial_;
+
+    FrameTimer(const FrameTimer&);
+    FrameTimer& operator=(const FrameTimer&);
+};
+
+#endif
@@ -0,0 +1,161 @@
+#include "Headless.h"
+#include <EGL/eglext.h>
+#include <cstdio>
+#include <cstdlib>
+
+HeadlessContext::HeadlessContext()
+    : display_(EGL_NO_DISPLAY), context_(EGL_NO_CONTEXT), fbo_(0),
+      color_buffer_(0), depth_buffer_(0), width_(0), height_(0),
+      pixels_(NULL) {
+}
+
+HeadlessContext::~HeadlessContext() {
+    destroy();
+}
+
+bool HeadlessContext::create(int width, int height) {
+    // prefer a surfaceless display, so no X server is needed
+    PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+        (PFNEGLGETPLATFORMDISPLAYEXTPROC) eglGetProcAddress("eglGetPlatformDisplayEXT");
+    if (getPlatformDisplay) {
+        display_ = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+    }
+    if (display_ == EGL_NO_DISPLAY) {
+        display_ = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    }
+    EGLint major, minor;
+    if (display_ == EGL_NO_DISPLAY || !eglInitialize(display_, &major, &minor)) {
+        fprintf(stderr, "headless: no EGL display\n");
+        return false;
+    }
+    if (!eglBindAPI(EGL_OPENGL_API)) {
+        fprintf(stderr, "headless: EGL has no desktop OpenGL\n");
+        return false;
+    }
+
+    const EGLint config_attribs[] = {
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_NONE
+    };
+    // we never draw to an EGL surface, so any config will do, or none
+    // at all where EGL_KHR_no_config_context is supported
+    EGLConfig config = EGL_NO_CONFIG_KHR;
+    EGLint n_configs = 0;
+    eglChooseConfig(display_, config_attribs, &config, 1, &n_configs);
+    if (n_configs < 1) {
+        config = EGL_NO_CONFIG_KHR;
+    }
+
+    // the shaders are GLSL 4.10
+    const EGLint context_attribs[] = {
+        EGL_CONTEXT_MAJOR_VERSION, 4,
+        EGL_CONTEXT_MINOR_VERSION, 1,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+        EGL_NONE
+    };
+    context_ = eglCreateContext(display_, config, EGL_NO_CONTEXT, context_attribs);
+    if (context_ == EGL_NO_CONTEXT ||
+        !eglMakeCurrent(display_, EGL_NO_SURFACE, EGL_NO_SURFACE, context_)) {
+        fprintf(stderr, "headless: can't make a surfaceless OpenGL 4.1 context\n");
+        return false;
+    }
+
+    // GLEW built for GLX complains there is no X display, but it has
+    // loaded the GL entry points by then
+    glewExperimental = GL_TRUE;
+    GLenum err = glewInit();
+    if (GLEW_OK != err) {
+        fprintf(stderr, "headless: glewInit says \"%s\", carrying on\n", glewGetErrorString(err));
+    }
+
+    width_ = width;
+    height_ = height;
+    glGenRenderbuffers(1, &color_buffer_);
+    glBindRenderbuffer(GL_RENDERBUFFER, color_buffer_);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+    glGenRenderbuffers(1, &depth_buffer_);
+    glBindRenderbuffer(GL_RENDERBUFFER, depth_buffer_);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    glGenFramebuffers(1, &fbo_);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo_);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                              GL_RENDERBUFFER, color_buffer_);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
+                              GL_RENDERBUFFER, depth_buffer_);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        fprintf(stderr, "headless: framebuffer is incomplete\n");
+        return false;
+    }
+    glViewport(0, 0, width, height);
+
+    pixels_ = (unsigned char*) malloc(4 * width * height);
+    printf("headless: %s, %dx%d\n", glGetString(GL_RENDERER), width, height);
+    return true;
+}
+
+void HeadlessContext::destroy() {
+    if (context_ != EGL_NO_CONTEXT) {
+        glDeleteFramebuffers(1, &fbo_);
+        glDeleteRenderbuffers(1, &color_buffer_);
+        glDeleteRenderbuffers(1, &depth_buffer_);
+        eglMakeCurrent(display_, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        eglDestroyContext(display_, context_);
+        context_ = EGL_NO_CONTEXT;
+    }
+    if (display_ != EGL_NO_DISPLAY) {
+        eglTerminate(display_);
+        display_ = EGL_NO_DISPLAY;
+    }
+    free(pixels_);
+    pixels_ = NULL;
+}
+
+GLuint HeadlessContext::framebuffer() const {
+    return fbo_;
+}
+
+int HeadlessContext::width() const {
+    return width_;
+}
+
+int HeadlessContext::height() const {
+    return height_;
+}
+
+void HeadlessContext::readPixels() {
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, fbo_);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, width_, height_, GL_RGBA, GL_UNSIGNED_BYTE, pixels_);
+}
+
+unsigned long long HeadlessContext::checksum() {
+    readPixels();
+
+    unsigned long long hash = 14695981039346656037ull;
+    size_t n = 4 * (size_t)width_ * height_;
+    for (size_t i = 0; i < n; ++i) {
+        hash ^= pixels_[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+bool HeadlessContext::savePPM(const char* path) {
+    readPixels();
+    FILE* file = fopen(path, "wb");
+    if (!file) {
+        perror(path);
+        return false;
+    }
+    fprintf(file, "P6\n%d %d\n255\n", width_, height_);
+    for (int y = height_ - 1; y >= 0; --y) { // GL rows start at the bottom
+        const unsigned char* row = pixels_ + 4 * (size_t)width_ * y;
+        for (int x = 0; x < width_; ++x) {
+            fwrite(row + 4 * x, 1, 3, file);
+        }
+    }
+    fclose(file);
+    return true;
+}
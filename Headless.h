@@ -0,0 +1,47 @@
+#ifndef HEADLESS_H
+#define HEADLESS_H
+
+#include <GL/glew.h>
+#include <EGL/egl.h>
+
+/* An OpenGL context with no window or display, for benchmarks and
+ pixel regression checks on machines without a monitor. Uses a
+ surfaceless EGL display (Mesa's llvmpipe works without any GPU) and
+ renders into an offscreen framebuffer, so nothing is ever paced by
+ vsync.
+ */
+class HeadlessContext
+{
+public:
+    HeadlessContext();
+    ~HeadlessContext();
+
+    // makes the context current and binds the framebuffer
+    bool create(int width, int height);
+    void destroy();
+
+    GLuint framebuffer() const;
+    int width() const;
+    int height() const;
+
+    // FNV-1a hash of the framebuffer's RGBA pixels
+    unsigned long long checksum();
+    bool savePPM(const char* path); // for eyeballing a changed checksum
+
+private:
+    void readPixels();
+
+    EGLDisplay display_;
+    EGLContext context_;
+    GLuint fbo_;
+    GLuint color_buffer_;
+    GLuint depth_buffer_;
+    int width_;
+    int height_;
+    unsigned char* pixels_;
+
+    HeadlessContext(const HeadlessContext&);
+    HeadlessContext& operator=(const HeadlessContext&);
+};
+
+#endif
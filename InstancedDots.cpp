@@ -0,0 +1,107 @@
+#include "InstancedDots.h"
+#include <cstddef>
+
+InstancedDots::InstancedDots(int max_instances)
+    : max_instances_(max_instances), uploaded_(0), upload_time_(0),
+      base_(NULL), vao_(0), vertex_buffer_(0), index_buffer_(0),
+      instance_buffer_(0), time_offset_location_(-1) {
+    dots_.reserve(max_instances);
+}
+
+InstancedDots::~InstancedDots() {
+}
+
+void InstancedDots::init(Mesh* base, float wrap_width) {
+    base_ = base;
+    time_offset_location_ = glGetUniformLocation(base->program_, "time_offset");
+    glProgramUniform1f(base->program_, glGetUniformLocation(base->program_, "wrap_width"),
+                       wrap_width);
+
+    glGenVertexArrays(1, &vao_);
+    glGenBuffers(1, &vertex_buffer_);
+    glGenBuffers(1, &index_buffer_);
+    glGenBuffers(1, &instance_buffer_);
+
+    glBindVertexArray(vao_);
+
+    glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer_);
+    glBufferData(GL_ARRAY_BUFFER, base->num_vertices_ * sizeof(Vertex2D),
+                 base->vertices_, GL_STATIC_DRAW);
+    glEnableVertexAttribArray(VERTEX_POSITION);
+    glVertexAttribPointer(VERTEX_POSITION, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex2D),
+                          (const GLvoid*) offsetof(Vertex2D, position));
+
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, index_buffer_);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, base->num_indices_ * sizeof(GLushort),
+                 base->indices_, GL_STATIC_DRAW);
+
+    glBindBuffer(GL_ARRAY_BUFFER, instance_buffer_);
+    glBufferData(GL_ARRAY_BUFFER, max_instances_ * sizeof(DotInstance),
+                 NULL, GL_DYNAMIC_DRAW);
+
+    glEnableVertexAttribArray(INSTANCE_POSITION);
+    glVertexAttribPointer(INSTANCE_POSITION, 2, GL_FLOAT, GL_FALSE, sizeof(DotInstance),
+                          (const GLvoid*) offsetof(DotInstance, position));
+    glVertexAttribDivisor(INSTANCE_POSITION, 1);
+
+    glEnableVertexAttribArray(INSTANCE_VELOCITY);
+    glVertexAttribPointer(INSTANCE_VELOCITY, 2, GL_FLOAT, GL_FALSE, sizeof(DotInstance),
+                          (const GLvoid*) offsetof(DotInstance, velocity));
+    glVertexAttribDivisor(INSTANCE_VELOCITY, 1);
+
+    glEnableVertexAttribArray(INSTANCE_SIZE);
+    glVertexAttribPointer(INSTANCE_SIZE, 1, GL_FLOAT, GL_FALSE, sizeof(DotInstance),
+                          (const GLvoid*) offsetof(DotInstance, size));
+    glVertexAttribDivisor(INSTANCE_SIZE, 1);
+
+    glEnableVertexAttribArray(INSTANCE_COLOR);
+    glVertexAttribPointer(INSTANCE_COLOR, 4, GL_UNSIGNED_BYTE, GL_FALSE, sizeof(DotInstance),
+                          (const GLvoid*) offsetof(DotInstance, color));
+    glVertexAttribDivisor(INSTANCE_COLOR, 1);
+
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void InstancedDots::clear() {
+    dots_.clear();
+}
+
+int InstancedDots::add(const DotInstance& dot) {
+    if ((int)dots_.size() == max_instances_) {
+        return -1;
+    }
+    dots_.push_back(dot);
+    return dots_.size() - 1;
+}
+
+DotInstance& InstancedDots::dot(int i) {
+    return dots_[i];
+}
+
+int InstancedDots::count() const {
+    return dots_.size();
+}
+
+void InstancedDots::upload(double t) {
+    uploaded_ = dots_.size();
+    upload_time_ = t;
+    if (uploaded_ == 0) {
+        return;
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, instance_buffer_);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, uploaded_ * sizeof(DotInstance), dots_.data());
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void InstancedDots::draw(double t) {
+    if (uploaded_ == 0) {
+        return;
+    }
+    glUseProgram(base_->program_);
+    glUniform1f(time_offset_location_, t - upload_time_);
+    glBindVertexArray(vao_);
+    glDrawElementsInstanced(GL_TRIANGLES, base_->num_indices_, GL_UNSIGNED_SHORT,
+                            NULL, uploaded_);
+    glBindVertexArray(0);
+}
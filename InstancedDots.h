@@ -0,0 +1,70 @@
+#ifndef INSTANCED_DOTS_H
+#define INSTANCED_DOTS_H
+
+#include <GL/glew.h>
+#include <stdint.h>
+#include <vector>
+#include "Mesh.h"
+#include "Renderer.h"
+
+enum INSTANCE_ATTRIBUTE_ID {
+    INSTANCE_POSITION = VERTEX_OBJECT + 1,
+    INSTANCE_VELOCITY,
+    INSTANCE_SIZE,
+    INSTANCE_COLOR
+};
+
+// one dot, in GL units and GL units / s
+typedef struct DotInstance {
+    float position[2];
+    float velocity[2];
+    float size; // scales the base geometry
+    uint8_t color[4];
+} DotInstance;
+
+/* Draws one base geometry, e.g. a unit circle from Mesh::circle(),
+ once per dot with a single glDrawElementsInstanced. Position,
+ velocity, size and color are per-instance attributes.
+
+ upload() sends the dots once, as they are at time t. draw(t) then
+ moves each dot by velocity * (t - upload time) in the vertex shader,
+ wrapping around a screen width, so dots on straight paths need no
+ further uploads; dots that steer can be changed and uploaded again,
+ at most once a frame.
+ */
+class InstancedDots
+{
+public:
+    explicit InstancedDots(int max_instances);
+    ~InstancedDots();
+
+    // needs a current GL context. base has its geometry and a program
+    // built from instanced_dots.vert; it is not added to the Renderer
+    void init(Mesh* base, float wrap_width);
+
+    void clear();
+    int add(const DotInstance& dot); // -1 when full
+    DotInstance& dot(int i);
+    int count() const;
+
+    void upload(double t);
+    void draw(double t);
+
+private:
+    int max_instances_;
+    std::vector<DotInstance> dots_;
+    int uploaded_; // instances on the GPU
+    double upload_time_;
+
+    Mesh* base_;
+    GLuint vao_;
+    GLuint vertex_buffer_;
+    GLuint index_buffer_;
+    GLuint instance_buffer_;
+    GLint time_offset_location_;
+
+    InstancedDots(const InstancedDots&);
+    InstancedDots& operator=(const InstancedDots&);
+};
+
+#endif
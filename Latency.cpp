@@ -0,0 +1,58 @@
+#include "Latency.h"
+#include <ctime>
+#include <cstring>
+
+double monotonicTime() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + 1e-9 * ts.tv_nsec;
+}
+
+const double LatencyHistogram::kBinWidth = 1e-4;
+
+LatencyHistogram::LatencyHistogram() {
+    reset();
+}
+
+void LatencyHistogram::add(double seconds) {
+    if (seconds < 0) {
+        seconds = 0;
+    }
+    int bin = (int)(seconds / kBinWidth);
+    bins_[(bin < kBins) ? bin : kBins]++;
+    count_++;
+    if (seconds > max_) {
+        max_ = seconds;
+    }
+}
+
+void LatencyHistogram::reset() {
+    memset(bins_, 0, sizeof(bins_));
+    count_ = 0;
+    max_ = 0;
+}
+
+int LatencyHistogram::count() const {
+    return count_;
+}
+
+double LatencyHistogram::percentile(double p) const {
+    if (count_ == 0) {
+        return 0;
+    }
+    // smallest bin edge with at least p% of the samples below it
+    double target = p / 100 * count_;
+    int seen = 0;
+    for (int i = 0; i < kBins; ++i) {
+        seen += bins_[i];
+        if (seen >= target) {
+            double edge = (i + 1) * kBinWidth;
+            return (edge < max_) ? edge : max_;
+        }
+    }
+    return max_;
+}
+
+double LatencyHistogram::max() const {
+    return max_;
+}
@@ -0,0 +1,31 @@
+#ifndef LATENCY_H
+#define LATENCY_H
+
+// seconds on a monotonic clock shared by every thread
+double monotonicTime();
+
+/* Histogram of latencies with 0.1 ms bins up to 250 ms. Anything
+ longer goes in an overflow bin; the maximum is always exact.
+ */
+class LatencyHistogram
+{
+public:
+    LatencyHistogram();
+
+    void add(double seconds);
+    void reset();
+
+    int count() const;
+    double percentile(double p) const; // p in [0, 100], in seconds
+    double max() const;
+
+private:
+    static const int kBins = 2500;
+    static const double kBinWidth;
+
+    int bins_[kBins + 1]; // last bin is overflow
+    int count_;
+    double max_;
+};
+
+#endif
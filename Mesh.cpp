@@ -1,8 +1,11 @@
 #include "Mesh.h"
 
 Mesh::Mesh(const char* vs_path, const char* fs_path)
-    : vertex_shader_path_(vs_path),
-      fragment_shader_path_(fs_path) {
+    : object_(-1), base_vertex_(0), first_index_(0),
+      num_vertices_(0), num_indices_(0), vertex_capacity_(0), index_capacity_(0),
+      vertices_(NULL), indices_(NULL),
+      vertex_shader_path_(vs_path),
+      fragment_shader_path_(fs_path), program_(0) {
           
     // set transform matrix to identity
     GLfloat matrix[16] = {
@@ -14,6 +17,11 @@ Mesh::Mesh(const char* vs_path, const char* fs_path)
     for (int i = 0; i < 16; ++i) {
         transform_matrix_[i] = matrix[i];
     }
+    
+    // no modulation
+    tint_[0] = tint_[1] = tint_[2] = tint_[3] = 1;
+    contrast_ = 1;
+    luminance_ = 1;
 }
 
 Mesh::~Mesh() {
@@ -21,6 +29,25 @@ Mesh::~Mesh() {
     free(indices_);
 }
 
+void Mesh::reserve(int max_vertices, int max_indices) {
+    if (max_vertices > vertex_capacity_) {
+        vertices_ = (Vertex2D*) realloc(vertices_, max_vertices * sizeof(Vertex2D));
+        vertex_capacity_ = max_vertices;
+    }
+    if (max_indices > index_capacity_) {
+        indices_ = (GLushort*) realloc(indices_, max_indices * sizeof(GLushort));
+        index_capacity_ = max_indices;
+    }
+}
+
+void Mesh::allocateVertices() {
+    reserve(num_vertices_, 0);
+}
+
+void Mesh::allocateIndices() {
+    reserve(0, num_indices_);
+}
+
 /*********** Color ********************************/
 void Mesh::color(float R, float G, float B, float A) {
     
@@ -38,6 +65,21 @@ void Mesh::color(float R, float G, float B, float A) {
     }
 }
 
+void Mesh::setTint(float r, float g, float b, float a) {
+    tint_[0] = r;
+    tint_[1] = g;
+    tint_[2] = b;
+    tint_[3] = a;
+}
+
+void Mesh::setContrast(float contrast) {
+    contrast_ = contrast;
+}
+
+void Mesh::setLuminance(float luminance) {
+    luminance_ = luminance;
+}
+
 /******** Simple spatial transforms *******************************/
 void Mesh::translateX(double dx) {
     transform_matrix_[12] += dx;
@@ -54,6 +96,14 @@ void Mesh::translateXmod(double dx, double n) {
     }
 }
 
+void Mesh::setX(double x) {
+    transform_matrix_[12] = x;
+}
+
+void Mesh::setXmod(double x, double n) {
+    transform_matrix_[12] = fmod(x, n);
+}
+
 void Mesh::translateY(double dy) {
     transform_matrix_[13] += dy;
 }
@@ -107,7 +157,7 @@ void Mesh::rect(float lower_x, float lower_y,
 void Mesh::makeVerticesRect(float lower_x, float lower_y,
                             float upper_x, float upper_y) {
     num_vertices_ = 4;
-    vertices_ = (Vertex2D*) malloc(num_vertices_ * sizeof(Vertex2D));
+    allocateVertices();
     
     vertices_[0].position[0] = lower_x;
     vertices_[0].position[1] = lower_y;
@@ -124,7 +174,7 @@ void Mesh::makeVerticesRect(float lower_x, float lower_y,
 
 void Mesh::makeIndicesRect() {
     num_indices_ = 6;
-    indices_ = (GLushort*) malloc(num_indices_ * sizeof(GLushort));
+    allocateIndices();
     
     // first triangle
     indices_[0] = 0;
@@ -149,7 +199,7 @@ void Mesh::makeVerticesCircle(float radius, float cx, float cy) {
      */
     GLfloat da = 10.0;
     num_vertices_ = 2 + (int)(360 / da);
-    vertices_ = (Vertex2D*) malloc(num_vertices_ * sizeof(Vertex2D));
+    allocateVertices();
    
     // first vertex is at the origin
     vertices_[0].position[0] = 0.0;
@@ -166,7 +216,7 @@ void Mesh::makeVerticesCircle(float radius, float cx, float cy) {
 
 void Mesh::makeIndicesCircle() {
     num_indices_ = 3 * (num_vertices_ - 1);
-    indices_ = (GLushort*) malloc(num_indices_ * sizeof(GLushort));
+    allocateIndices();
 
     int j = 1;
     for (int i = 0; i < num_indices_ - 1; i += 3) {
@@ -201,7 +251,7 @@ void Mesh::makeLinearGratingVertices(int periods) {
     int num_squares = 3 * 2 * periods;
     num_vertices_ = 2 * 4 * num_squares;
     
-    vertices_ = (Vertex2D*) malloc(num_vertices_ * sizeof(Vertex2D));
+    allocateVertices();
     
     float w_step;
     int N;
@@ -296,7 +346,7 @@ void Mesh::makeRotatingGratingVertices(int periods) {
     num_vertices_ =  4 * num_squares;
     
     // allocate an array of vertex structs
-    vertices_ = (Vertex2D*) malloc(num_vertices_ * sizeof(Vertex2D));
+    allocateVertices();
     
     // set step size along x-axis
     float x_step;
@@ -376,7 +426,7 @@ void Mesh::makeRotatingGratingIndices(int periods) {
     int num_rects = indices_per_rectangle * periods;
     num_indices_ = indices_per_rectangle * num_rects;
     
-    indices_ = (GLushort*) malloc(num_indices_ * sizeof(GLushort));
+    allocateIndices();
     
     int vi = 0, ii = 0, N;
     
@@ -401,7 +451,7 @@ void Mesh::makeLinearGratingIndices(int periods) {
     int num_squares = indices_per_rectangle * periods;
     num_indices_ = 2 * indices_per_rectangle * num_squares;
     
-    indices_ = (GLushort*) malloc(num_indices_ * sizeof(GLushort));
+    allocateIndices();
     
     int vi = 0, ii = 0, N;
     
@@ -19,25 +19,35 @@ public:
     
     float aspect_ratio_;
     
-    // buffer id's for this mesh
-    GLuint vertex_buffer_;
-    GLuint index_buffer_;
-    GLuint vao_;
+    // where the mesh lives in the Renderer's arena, object_ is -1
+    // until it has been added
+    int object_;
+    int base_vertex_;
+    int first_index_;
 
-    // vertex and index data defining the mesh 
+    // vertex and index data defining the mesh. the arrays are only
+    // reallocated when a rebuild needs more room than they have
     int num_vertices_;
     int num_indices_;
+    int vertex_capacity_;
+    int index_capacity_;
     Vertex2D* vertices_;
     GLushort* indices_;
 
     // this is uniform data to pass to shaders
     GLfloat transform_matrix_[16];
+    GLfloat tint_[4];     // multiplies the vertex colors, 0-1
+    GLfloat contrast_;    // about the mesh's mean color, 1 as built
+    GLfloat luminance_;   // multiplies the result, 1 as built
 
     // in my experience, each mesh will want it's own GLSL program
     const char* vertex_shader_path_;
     const char* fragment_shader_path_;
     GLuint program_;
-    GLint transform_matrix_location_;
+    
+    // room for the largest geometry the mesh will be rebuilt with,
+    // before it is added to the Renderer
+    void reserve(int max_vertices, int max_indices);
     
     // functions create vertex and index data defining the mesh
     void rect(float lower_x, float lower_y,
@@ -58,10 +68,17 @@ public:
     void makeLinearGratingVertices(int periods);
     void makeLinearGratingIndices(int periods);
     
-    // simple functions to modify color, position, shape of mesh
+    // simple functions to modify color, position, shape of mesh.
+    // color() rewrites the vertices; the set* calls below it are
+    // applied by the shaders, so they are free to change every frame
     void color(float R, float G, float B, float A);
+    void setTint(float r, float g, float b, float a);
+    void setContrast(float contrast);
+    void setLuminance(float luminance);
     void translateX(double dx);
     void translateXmod(double dx, double n);
+    void setX(double x);
+    void setXmod(double x, double n); // wrapped into (-n, n) like translateXmod
     void translateY(double dy);
     void translateYmod(double dy, double n);
     void translateZ(double dz);
@@ -71,6 +88,12 @@ public:
     void scaleXY(double da);
     void resetScale();
     
+private:
+    void allocateVertices(); // for num_vertices_, keeping the contents
+    void allocateIndices();
+    
+    Mesh(const Mesh&);
+    Mesh& operator=(const Mesh&);
 };
     
 #endif
@@ -0,0 +1,71 @@
+#include "ProceduralGrating.h"
+#include <cmath>
+
+ProceduralGrating::ProceduralGrating()
+    : program_(0), frequency_location_(-1), duty_cycle_location_(-1),
+      waveform_location_(-1), contrast_location_(-1),
+      orientation_location_(-1), phase_location_(-1),
+      frequency_(0), phase_(0) {
+}
+
+void ProceduralGrating::init(GLuint program, float width_deg) {
+    program_ = program;
+    frequency_location_ = glGetUniformLocation(program, "frequency");
+    duty_cycle_location_ = glGetUniformLocation(program, "duty_cycle");
+    waveform_location_ = glGetUniformLocation(program, "waveform");
+    contrast_location_ = glGetUniformLocation(program, "contrast");
+    orientation_location_ = glGetUniformLocation(program, "orientation");
+    phase_location_ = glGetUniformLocation(program, "phase");
+    glProgramUniform1f(program, glGetUniformLocation(program, "width_deg"), width_deg);
+
+    // defaults match the stripe-geometry gratings
+    setFrequency(0.04);
+    setDutyCycle(0.5);
+    setWaveform(GRATING_SQUARE);
+    setContrast(1);
+    setOrientation(0);
+    setPhase(0);
+    setCylinder(true);
+}
+
+void ProceduralGrating::setFrequency(float cycles_per_deg) {
+    frequency_ = cycles_per_deg;
+    glProgramUniform1f(program_, frequency_location_, cycles_per_deg);
+}
+
+void ProceduralGrating::setDutyCycle(float duty) {
+    glProgramUniform1f(program_, duty_cycle_location_, duty);
+}
+
+void ProceduralGrating::setWaveform(GratingWaveform waveform) {
+    glProgramUniform1i(program_, waveform_location_, waveform);
+}
+
+void ProceduralGrating::setContrast(float contrast) {
+    glProgramUniform1f(program_, contrast_location_, contrast);
+}
+
+void ProceduralGrating::setOrientation(float deg) {
+    glProgramUniform1f(program_, orientation_location_, deg * M_PI / 180);
+}
+
+void ProceduralGrating::setPhase(double cycles) {
+    phase_ = cycles - floor(cycles);
+    glProgramUniform1f(program_, phase_location_, phase_);
+}
+
+void ProceduralGrating::advance(double deg) {
+    setPhase(phase_ + frequency_ * deg);
+}
+
+void ProceduralGrating::setCylinder(bool cylinder) {
+    glProgramUniform1i(program_, glGetUniformLocation(program_, "cylinder"), cylinder);
+}
+
+float ProceduralGrating::frequency() const {
+    return frequency_;
+}
+
+double ProceduralGrating::phase() const {
+    return phase_;
+}
@@ -0,0 +1,53 @@
+#ifndef PROCEDURAL_GRATING_H
+#define PROCEDURAL_GRATING_H
+
+#include <GL/glew.h>
+
+enum GratingWaveform {
+    GRATING_SQUARE,
+    GRATING_SINE
+};
+
+/* Parameters of a grating evaluated per pixel by
+ procedural_grating.frag. The geometry is a single rectangle, so
+ changing frequency, contrast etc. between trials is a uniform update
+ and never touches the vertex arena. Motion advances the phase instead
+ of translating the mesh.
+
+ Setters write straight to the program with glProgramUniform, so they
+ can be called at any point in the frame.
+ */
+class ProceduralGrating
+{
+public:
+    ProceduralGrating();
+
+    // program built from procedural_grating.vert/.frag
+    void init(GLuint program, float width_deg);
+
+    void setFrequency(float cycles_per_deg);
+    void setDutyCycle(float duty);
+    void setWaveform(GratingWaveform waveform);
+    void setContrast(float contrast);
+    void setOrientation(float deg); // 0 is vertical bars moving along x
+    void setPhase(double cycles);
+    void advance(double deg); // move the pattern across its bars
+    void setCylinder(bool cylinder); // false when a WarpPass projects the scene
+
+    float frequency() const;
+    double phase() const;
+
+private:
+    GLuint program_;
+    GLint frequency_location_;
+    GLint duty_cycle_location_;
+    GLint waveform_location_;
+    GLint contrast_location_;
+    GLint orientation_location_;
+    GLint phase_location_;
+
+    float frequency_;
+    double phase_; // kept in [0, 1) so the float uniform stays precise
+};
+
+#endif
@@ -0,0 +1,191 @@
+#include "ProgramCache.h"
+#include "load_shader.h"
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include <sys/stat.h>
+
+static unsigned long long fnv1a(const void* data, size_t n, unsigned long long hash) {
+    const unsigned char* p = (const unsigned char*) data;
+    for (size_t i = 0; i < n; ++i) {
+        hash ^= p[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+static unsigned long long fnv1a(const char* s, unsigned long long hash) {
+    // includes the terminator, so "ab" + "c" and "a" + "bc" differ
+    return s ? fnv1a(s, strlen(s) + 1, hash) : hash;
+}
+
+ProgramCache::ProgramCache()
+    : use_binaries_(false), driver_hash_(14695981039346656037ull),
+      compiled_(0), loaded_(0) {
+}
+
+void ProgramCache::init(const char* dir) {
+    driver_hash_ = fnv1a((const char*) glGetString(GL_VENDOR), driver_hash_);
+    driver_hash_ = fnv1a((const char*) glGetString(GL_RENDERER), driver_hash_);
+    driver_hash_ = fnv1a((const char*) glGetString(GL_VERSION), driver_hash_);
+
+    GLint formats = 0;
+    if (GLEW_ARB_get_program_binary) {
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    }
+    if (dir && formats > 0) {
+        dir_ = dir;
+        mkdir(dir, 0755); // fails harmlessly if it is already there
+        use_binaries_ = true;
+    } else if (dir) {
+        printf("program binaries not supported, shaders are compiled every launch\n");
+    }
+}
+
+GLuint ProgramCache::program(const char* vs_path, const char* fs_path) {
+    std::string vs_source = shaderSource(GL_VERTEX_SHADER, vs_path);
+    std::string fs_source = shaderSource(GL_FRAGMENT_SHADER, fs_path);
+    unsigned long long key = fnv1a(vs_source.c_str(), driver_hash_);
+    key = fnv1a(fs_source.c_str(), key);
+
+    std::map<unsigned long long, GLuint>::iterator it = programs_.find(key);
+    if (it != programs_.end()) {
+        return it->second;
+    }
+
+    char name[32];
+    snprintf(name, sizeof(name), "/%016llx.bin", key);
+    std::string binary_path = dir_ + name;
+
+    GLuint program = use_binaries_ ? loadBinary(binary_path) : 0;
+    if (program) {
+        loaded_++;
+    } else {
+        program = glCreateProgram();
+        glAttachShader(program, shader(GL_VERTEX_SHADER, vs_source, vs_path));
+        glAttachShader(program, shader(GL_FRAGMENT_SHADER, fs_source, fs_path));
+        if (use_binaries_) {
+            glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+        }
+        glLinkProgram(program);
+        GLint linked;
+        glGetProgramiv(program, GL_LINK_STATUS, &linked);
+        if (!linked) {
+            programerrors(program);
+            throw 4;
+        }
+        compiled_++;
+        if (use_binaries_) {
+            saveBinary(program, binary_path);
+        }
+    }
+    programs_[key] = program;
+    return program;
+}
+
+GLuint ProgramCache::shader(GLenum type, const std::string& source, const char* path) {
+    unsigned long long key = fnv1a(source.c_str(), fnv1a(&type, sizeof(type), driver_hash_));
+    std::map<unsigned long long, GLuint>::iterator it = shaders_.find(key);
+    if (it != shaders_.end()) {
+        return it->second;
+    }
+    GLuint shader = glCreateShader(type);
+    const GLchar* text = source.c_str();
+    glShaderSource(shader, 1, &text, NULL);
+    glCompileShader(shader);
+    GLint compiled;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
+    if (!compiled) {
+        fprintf(stderr, "%s:\n", path);
+        shadererrors(shader);
+        throw 3;
+    }
+    shaders_[key] = shader;
+    return shader;
+}
+
+GLuint ProgramCache::loadBinary(const std::string& path) {
+    FILE* file = fopen(path.c_str(), "rb");
+    if (!file) {
+        return 0;
+    }
+    GLenum format = 0;
+    std::vector<char> binary;
+    if (fread(&format, sizeof(format), 1, file) == 1) {
+        fseek(file, 0, SEEK_END);
+        long size = ftell(file) - sizeof(format);
+        fseek(file, sizeof(format), SEEK_SET);
+        if (size > 0) {
+            binary.resize(size);
+            if (fread(binary.data(), 1, size, file) != (size_t)size) {
+                binary.clear();
+            }
+        }
+    }
+    fclose(file);
+    if (binary.empty()) {
+        return 0;
+    }
+
+    GLuint program = glCreateProgram();
+    glProgramBinary(program, format, binary.data(), binary.size());
+    GLint linked;
+    glGetProgramiv(program, GL_LINK_STATUS, &linked);
+    if (!linked) {
+        // stale or from another driver build
+        glDeleteProgram(program);
+        return 0;
+    }
+    return program;
+}
+
+void ProgramCache::saveBinary(GLuint program, const std::string& path) {
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) {
+        return;
+    }
+    std::vector<char> binary(length);
+    GLenum format;
+    glGetProgramBinary(program, length, &length, &format, binary.data());
+
+    // written to a temporary then renamed, so a crash never leaves a
+    // truncated binary behind
+    std::string tmp = path + ".tmp";
+    FILE* file = fopen(tmp.c_str(), "wb");
+    if (!file) {
+        return;
+    }
+    bool ok = fwrite(&format, sizeof(format), 1, file) == 1 &&
+              fwrite(binary.data(), 1, length, file) == (size_t)length;
+    ok = (fclose(file) == 0) && ok;
+    if (!ok || rename(tmp.c_str(), path.c_str()) != 0) {
+        remove(tmp.c_str());
+    }
+}
+
+void ProgramCache::releaseShaders() {
+    // programs keep working once their shaders are deleted
+    std::map<unsigned long long, GLuint>::iterator it;
+    for (it = programs_.begin(); it != programs_.end(); ++it) {
+        GLint count = 0;
+        glGetProgramiv(it->second, GL_ATTACHED_SHADERS, &count);
+        std::vector<GLuint> attached(count > 0 ? count : 1);
+        glGetAttachedShaders(it->second, count, NULL, attached.data());
+        for (int i = 0; i < count; ++i) {
+            glDetachShader(it->second, attached[i]);
+        }
+    }
+    for (it = shaders_.begin(); it != shaders_.end(); ++it) {
+        glDeleteShader(it->second);
+    }
+    shaders_.clear();
+}
+
+int ProgramCache::compiled() const {
+    return compiled_;
+}
+
+int ProgramCache::loaded() const {
+    return loaded_;
+}
@@ -0,0 +1,53 @@
+#ifndef PROGRAM_CACHE_H
+#define PROGRAM_CACHE_H
+
+#include <GL/glew.h>
+#include <map>
+#include <string>
+
+/* Builds GLSL programs from vertex/fragment shader files, once each.
+
+ Programs are keyed on a hash of both sources, so meshes drawn with
+ the same shaders share one program, and a shader used by several
+ programs is compiled once. Linked programs are also written to
+ <dir>/<key>.bin with glGetProgramBinary and loaded from there with
+ glProgramBinary on the next launch, skipping compilation entirely.
+ The key includes the GL vendor, renderer and version, so a driver
+ update just misses the cache; a binary the driver rejects is rebuilt
+ from source.
+ */
+class ProgramCache
+{
+public:
+    ProgramCache();
+
+    // needs a current GL context. dir is created if it doesn't exist;
+    // NULL keeps the cache in memory only
+    void init(const char* dir);
+
+    GLuint program(const char* vs_path, const char* fs_path);
+
+    // frees the shader objects once every program has been built
+    void releaseShaders();
+
+    int compiled() const;
+    int loaded() const; // from disk
+
+private:
+    GLuint shader(GLenum type, const std::string& source, const char* path);
+    GLuint loadBinary(const std::string& path);
+    void saveBinary(GLuint program, const std::string& path);
+
+    std::string dir_;
+    bool use_binaries_;
+    unsigned long long driver_hash_;
+    std::map<unsigned long long, GLuint> programs_; // by source hash
+    std::map<unsigned long long, GLuint> shaders_;
+    int compiled_;
+    int loaded_;
+
+    ProgramCache(const ProgramCache&);
+    ProgramCache& operator=(const ProgramCache&);
+};
+
+#endif
@@ -1,183 +1,621 @@
 #include "Protocol.h"
+#include "RecordFile.h"
+#include "Random.h"
+#include <cstring>
+#include <string>
+#include <vector>
+
+static const char* kFactorNames[FACTOR_TOTAL] = {
+    "mode", "speed", "size", "gain", "frequency", "count"
+};
+
+// the level of a factor a design doesn't list
+static const float kFactorDefaults[FACTOR_TOTAL] = {
+    0, 10, 1, 1, 0.04, 1
+};
+
+static const char* kOrderNames[3] = {
+    "sequential", "random", "blocks"
+};
+
+// by experiment type
+static const int kStimuli = 6;
+static const char* kStimulusNames[kStimuli] = {
+    "open_loop_omr", "open_loop_prey", "closed_loop_omr", "closed_loop_prey",
+    "grating_sweep", "prey_swarm"
+};
+
+/******** Built-in designs, in the protocol file format ********/
+
+static const char* kOpenLoopStepOMR =
+    "name open_loop_step_omr\n"
+    "stimulus open_loop_omr\n"
+    "factor speed 10\n"
+    "factor mode 0 1 2\n"
+    "reps 20\n"
+    "trial_duration 10\n"
+    "inter_trial 10\n"
+    "order random\n";
+
+static const char* kOpenLoopPrey =
+    "name open_loop_prey\n"
+    "stimulus open_loop_prey\n"
+    "factor speed 30 60 90 120 150\n"
+    "factor size 1 3 5 7 20 30\n"
+    "reps 5\n"
+    "trial_duration 0\n"
+    "inter_trial 10\n"
+    "order random\n";
+
+static const char* kClosedLoopStepOMR =
+    "name closed_loop_step_omr\n"
+    "stimulus closed_loop_omr\n"
+    "factor speed 10\n"
+    "factor gain 2 1 -1 -2\n"
+    "factor mode 0 1\n"
+    "reps 5\n"
+    "trial_duration 30\n"
+    "inter_trial 10\n"
+    "order random\n"
+    "block_by gain\n";
+
+// rotating square-wave gratings, spatial frequency varied per trial
+static const char* kOpenLoopGratingSweep =
+    "name open_loop_grating_sweep\n"
+    "stimulus grating_sweep\n"
+    "factor speed 10\n"
+    "factor frequency 0.01 0.02 0.04 0.08 0.16\n"
+    "factor mode 0 1\n"
+    "reps 5\n"
+    "trial_duration 10\n"
+    "inter_trial 10\n"
+    "order random\n";
+
+// swarms of prey-like dots drifting across the screen, number and
+// size of the dots varied per trial
+static const char* kOpenLoopPreySwarm =
+    "name open_loop_prey_swarm\n"
+    "stimulus prey_swarm\n"
+    "factor speed 60\n"
+    "factor count 1 10 50 200\n"
+    "factor size 1 3 7\n"
+    "reps 5\n"
+    "trial_duration 10\n"
+    "inter_trial 10\n"
+    "order random\n";
 
 Protocol::Protocol()
-    : size_index_(0), speed_index_(0), mode_index_(0), gain_index_(0) {
-    srand(time(NULL));
+    : columns_(NULL), seed_(0), groups_(1) {
+    memset(&table_, 0, sizeof(table_));
+    for (int f = 0; f < FACTOR_TOTAL; ++f) {
+        stride_[f] = 1;
+        levels_[f] = 1;
+    }
 }
 
 Protocol::~Protocol() {
-    free(size_array_);
-    free(speed_array_);
-    free(mode_array_);
-    free(gain_array_);
-}
-
-void Protocol::createOpenLoopStepOMR(bool saveit, char* path) {
-    const int n_speeds = 1, n_modes = 3, n_reps = 20;
-    float speed_set[n_speeds] = {10.0};
-    int mode_set[n_modes] = {0, 1, 2};
-    length_ = n_modes * n_speeds * n_reps;
-    
-    mode_array_ = (int*) malloc(length_ * sizeof(int));
-    speed_array_ = (float*) malloc(length_ * sizeof(float));
-    size_array_ = (int*) malloc(length_ * sizeof(int));
-    gain_array_ = (float*) malloc(length_ * sizeof(float));
-    
-    int arr_i = 0;
-    for (int i = 0; i < n_speeds; i++) {
-        for (int j = 0; j < n_modes; j++) {
-            for (int k = 0; k < n_reps; k++) {
-                mode_array_[arr_i + k] = mode_set[j];
-                speed_array_[arr_i + k] = speed_set[i];
-            }
-            arr_i += n_reps;
-        }
-    }
-    
-    shuffle(mode_array_);
-    shuffle(speed_array_);
-    
-    if (saveit) {
-        FILE* file = fopen(path, "w");
-        for (int i = 0; i < length_; ++i) {
-            fprintf(file, "%d ", mode_array_[i]);
-        }
-        fprintf(file, "\n");
-        for (int i = 0; i < length_; ++i) {
-            fprintf(file, "%f ", speed_array_[i]);
-        }
-        fclose(file);
-    }
-}
-
-void Protocol::createClosedLoopStepOMR(bool saveit, char* path) {
-    const int n_speeds = 1, n_modes = 2, n_reps = 5, n_gains = 4;
-    float speed_set[n_speeds] = {10.0};
-    int mode_set[n_modes] = {0, 1};
-    float gain_set[n_gains] = {2.0, 1.0, -1.0, -2.0};
-    
-    length_ = n_modes * n_speeds * n_reps * n_gains;
-    mode_array_ = (int*) malloc(length_ * sizeof(int));
-    speed_array_ = (float*) malloc(length_ * sizeof(float));
-    size_array_ = (int*) malloc(length_ * sizeof(int));
-    gain_array_ = (float*) malloc(length_ * sizeof(float));
-    
-    for (int i = 0; i < length_; ++i) {
-        speed_array_[i] = speed_set[0];
-    }
-    
-    int arr_i = 0;
-    for (int i = 0; i < n_gains; i++) {
-        for (int j = 0; j < n_modes; j++) {
-            for (int k = 0; k < n_reps; k++) {
-                mode_array_[arr_i + k] = mode_set[j];
-                gain_array_[arr_i + k] = gain_set[i];
-            }
-            arr_i += n_reps;
-        }
-    }
-    
-    shuffle(mode_array_);
-    
-    if (saveit) {
-        FILE* file = fopen(path, "w");
-        for (int i = 0; i < length_; ++i) {
-            fprintf(file, "%d ", mode_array_[i]);
-        }
-        fprintf(file, "\n");
-        for (int i = 0; i < length_; ++i) {
-            fprintf(file, "%f ", speed_array_[i]);
-        }
-        fprintf(file, "\n");
-        for (int i = 0; i < length_; ++i) {
-            fprintf(file, "%f ", gain_array_[i]);
-        }
-        fclose(file);
-    }
-}
-
-void Protocol::createOpenLoopPrey(bool saveit, char* path) {
-    const int n_speeds = 5, n_sizes = 6, n_reps = 5;
-    float speed_set[n_speeds] = {30, 60, 90, 120, 150};
-    int size_set[n_sizes] = {1, 3, 5, 7, 20, 30};
-    length_ = n_speeds * n_sizes * n_reps; // 5x reps for each speed-size combo
-    
-    size_array_ = (int*) malloc(length_ * sizeof(int));
-    speed_array_ = (float*) malloc(length_ * sizeof(float));
-    mode_array_ = (int*) malloc(length_ * sizeof(int));
-    gain_array_ = (float*) malloc(length_ * sizeof(float));
-    
-    int arr_i = 0;
-    for(int i = 0; i < n_speeds; i++) {
-        for(int j = 0; j < n_sizes; j++) {
-            for(int k = 0; k < n_reps; k++) {
-                size_array_[arr_i + k] = size_set[j];
-                speed_array_[arr_i + k] = speed_set[i];
-            }
-            arr_i += n_reps;
-        }
-    }
-    
-    shuffle(size_array_);
-    shuffle(speed_array_);
-    
-    if (saveit) {
-        FILE* file = fopen(path, "w");
-        for (int i = 0; i < length_; ++i) {
-            fprintf(file, "%d ", size_array_[i]);
+    free(columns_);
+}
+
+bool Protocol::load(const char* path, ProtocolDesign* design) {
+    FILE* file = fopen(path, "rb");
+    if (!file) {
+        fprintf(stderr, "could not open protocol file %s\n", path);
+        return false;
+    }
+    std::string text;
+    char buf[4096];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), file)) > 0) {
+        text.append(buf, n);
+    }
+    fclose(file);
+    return parse(text.c_str(), path, design);
+}
+
+bool Protocol::builtin(int experiment_type, ProtocolDesign* design) {
+    switch (experiment_type) {
+        case OPEN_LOOP_OMR:
+            return parse(kOpenLoopStepOMR, "built-in", design);
+        case OPEN_LOOP_PREY:
+            return parse(kOpenLoopPrey, "built-in", design);
+        case CLOSED_LOOP_OMR:
+            return parse(kClosedLoopStepOMR, "built-in", design);
+        case OPEN_LOOP_GRATING_SWEEP:
+            return parse(kOpenLoopGratingSweep, "built-in", design);
+        case OPEN_LOOP_PREY_SWARM:
+            return parse(kOpenLoopPreySwarm, "built-in", design);
+    }
+    return false;
+}
+
+static int factorNamed(const char* name) {
+    for (int f = 0; f < FACTOR_TOTAL; ++f) {
+        if (strcmp(name, kFactorNames[f]) == 0) {
+            return f;
         }
-        fprintf(file, "\n");
-        for (int i = 0; i < length_; ++i) {
-            fprintf(file, "%f ", speed_array_[i]);
+    }
+    return -1;
+}
+
+static bool number(const char* s, double* x) {
+    char* end;
+    *x = strtod(s, &end);
+    return end != s && *end == '\0' && std::isfinite(*x);
+}
+
+bool Protocol::parse(const char* text, const char* source, ProtocolDesign* design) {
+    memset(design, 0, sizeof(*design));
+    design->stimulus = -1;
+    design->reps = 1;
+    design->trial_duration = 10;
+    design->inter_trial = 10;
+    design->order = ORDER_RANDOM;
+    design->block_by = -1;
+    for (int f = 0; f < FACTOR_TOTAL; ++f) {
+        design->levels[f] = 1;
+        design->level[f][0] = kFactorDefaults[f];
+    }
+
+    int line_number = 0;
+    const char* line = text;
+    while (*line) {
+        line_number++;
+        const char* eol = strchr(line, '\n');
+        size_t length = eol ? eol - line : strlen(line);
+        std::string copy(line, length);
+        line = eol ? eol + 1 : line + length;
+
+        size_t comment = copy.find('#');
+        if (comment != std::string::npos) {
+            copy.resize(comment);
         }
-        fclose(file);
+        char* save;
+        char* key = strtok_r(&copy[0], " \t\r", &save);
+        if (!key) {
+            continue; // blank
+        }
+        const char* args[PROTOCOL_MAX_LEVELS + 1];
+        int n_args = 0;
+        char* arg;
+        while ((arg = strtok_r(NULL, " \t\r", &save))) {
+            if (n_args == PROTOCOL_MAX_LEVELS + 1) {
+                fprintf(stderr, "%s:%d: too many values, at most %d levels per factor\n",
+                        source, line_number, PROTOCOL_MAX_LEVELS);
+                return false;
+            }
+            args[n_args++] = arg;
+        }
+
+        double x = 0;
+        if (strcmp(key, "name") == 0 && n_args == 1) {
+            strncpy(design->name, args[0], sizeof(design->name) - 1);
+
+        } else if (strcmp(key, "stimulus") == 0 && n_args == 1) {
+            design->stimulus = -1;
+            for (int s = 0; s < kStimuli; ++s) {
+                if (strcmp(args[0], kStimulusNames[s]) == 0) {
+                    design->stimulus = s;
+                }
+            }
+            if (design->stimulus < 0) {
+                fprintf(stderr, "%s:%d: unknown stimulus '%s'\n", source, line_number, args[0]);
+                return false;
+            }
+
+        } else if (strcmp(key, "factor") == 0 && n_args >= 2) {
+            int f = factorNamed(args[0]);
+            if (f < 0) {
+                fprintf(stderr, "%s:%d: unknown factor '%s'\n", source, line_number, args[0]);
+                return false;
+            }
+            for (int k = 0; k < design->factors; ++k) {
+                if (design->listed[k] == f) {
+                    fprintf(stderr, "%s:%d: factor '%s' given twice\n",
+                            source, line_number, args[0]);
+                    return false;
+                }
+            }
+            design->listed[design->factors++] = f;
+            design->levels[f] = n_args - 1;
+            for (int i = 1; i < n_args; ++i) {
+                if (!number(args[i], &x)) {
+                    fprintf(stderr, "%s:%d: '%s' is not a number\n", source, line_number, args[i]);
+                    return false;
+                }
+                design->level[f][i - 1] = x;
+            }
+
+        } else if (strcmp(key, "reps") == 0 && n_args == 1) {
+            if (!number(args[0], &x) || x < 1 || x != floor(x)) {
+                fprintf(stderr, "%s:%d: reps must be a positive integer\n", source, line_number);
+                return false;
+            }
+            design->reps = (x < PROTOCOL_MAX_TRIALS) ? x : PROTOCOL_MAX_TRIALS;
+
+        } else if ((strcmp(key, "trial_duration") == 0 || strcmp(key, "inter_trial") == 0) &&
+                   n_args == 1) {
+            if (!number(args[0], &x) || x < 0) {
+                fprintf(stderr, "%s:%d: %s must be a duration in seconds\n",
+                        source, line_number, key);
+                return false;
+            }
+            if (strcmp(key, "trial_duration") == 0) {
+                design->trial_duration = x;
+            } else {
+                design->inter_trial = x;
+            }
+
+        } else if (strcmp(key, "order") == 0 && n_args == 1) {
+            design->order = -1;
+            for (int o = 0; o < 3; ++o) {
+                if (strcmp(args[0], kOrderNames[o]) == 0) {
+                    design->order = o;
+                }
+            }
+            if (design->order < 0) {
+                fprintf(stderr, "%s:%d: order must be sequential, random or blocks\n",
+                        source, line_number);
+                return false;
+            }
+
+        } else if (strcmp(key, "block_by") == 0 && n_args == 1) {
+            design->block_by = factorNamed(args[0]);
+            if (design->block_by < 0) {
+                fprintf(stderr, "%s:%d: unknown factor '%s'\n", source, line_number, args[0]);
+                return false;
+            }
+
+        } else if (strcmp(key, "max_run") == 0 && n_args == 2) {
+            int f = factorNamed(args[0]);
+            if (f < 0) {
+                fprintf(stderr, "%s:%d: unknown factor '%s'\n", source, line_number, args[0]);
+                return false;
+            }
+            if (!number(args[1], &x) || x < 1 || x != floor(x)) {
+                fprintf(stderr, "%s:%d: max_run must be a positive integer\n",
+                        source, line_number);
+                return false;
+            }
+            design->max_run[f] = (x < PROTOCOL_MAX_TRIALS) ? x : PROTOCOL_MAX_TRIALS;
+
+        } else if (strcmp(key, "seed") == 0 && n_args == 1) {
+            char* end;
+            design->seed = strtoull(args[0], &end, 0);
+            if (*end != '\0' || args[0][0] == '-') {
+                fprintf(stderr, "%s:%d: seed must be an unsigned integer\n",
+                        source, line_number);
+                return false;
+            }
+            design->seeded = true;
+
+        } else {
+            fprintf(stderr, "%s:%d: can't make sense of '%s' with %d value(s)\n",
+                    source, line_number, key, n_args);
+            return false;
+        }
+    }
+
+    if (design->name[0] == '\0' && design->stimulus >= 0) {
+        strcpy(design->name, kStimulusNames[design->stimulus]);
     }
+    return validate(*design, source);
 }
 
-void Protocol::reset() {
-    size_index_ = 0;
-    speed_index_ = 0;
-    mode_index_ = 0;
-    gain_index_ = 0;
+bool Protocol::validate(const ProtocolDesign& design, const char* source) {
+    if (design.stimulus < 0) {
+        fprintf(stderr, "%s: no stimulus given\n", source);
+        return false;
+    }
+    if (design.stimulus == CLOSED_LOOP_PREY) {
+        fprintf(stderr, "%s: closed-loop prey isn't implemented\n", source);
+        return false;
+    }
+
+    double trials = Protocol::trials(design);
+    if (trials > PROTOCOL_MAX_TRIALS) {
+        fprintf(stderr, "%s: %.0f trials, at most %d are allowed\n",
+                source, trials, PROTOCOL_MAX_TRIALS);
+        return false;
+    }
+
+    for (int f = 0; f < FACTOR_TOTAL; ++f) {
+        for (int i = 0; i < design.levels[f]; ++i) {
+            float x = design.level[f][i];
+            bool integer = (x == floor(x));
+            const char* problem = NULL;
+            if (f == FACTOR_MODE && (!integer || x < 0 || x > 2)) {
+                problem = "must be 0, 1 or 2";
+            } else if (f == FACTOR_SPEED && x <= 0) {
+                problem = "must be positive";
+            } else if ((f == FACTOR_SIZE || f == FACTOR_COUNT) && (!integer || x < 1)) {
+                problem = "must be a positive integer";
+            } else if (f == FACTOR_FREQUENCY && x <= 0) {
+                problem = "must be positive";
+            }
+            if (problem) {
+                fprintf(stderr, "%s: %s %g %s\n", source, kFactorNames[f], x, problem);
+                return false;
+            }
+        }
+    }
+    if (design.block_by >= 0 && design.max_run[design.block_by] > 0) {
+        fprintf(stderr, "%s: %s is blocked, so it can't also have a max_run\n",
+                source, kFactorNames[design.block_by]);
+        return false;
+    }
+    for (int f = 0; f < FACTOR_TOTAL; ++f) {
+        if (design.max_run[f] > 0 && design.levels[f] < 2) {
+            fprintf(stderr, "%s: max_run %s needs at least two levels of it\n",
+                    source, kFactorNames[f]);
+            return false;
+        }
+    }
+    if (design.trial_duration == 0 && design.stimulus != OPEN_LOOP_PREY) {
+        fprintf(stderr, "%s: trial_duration 0 is only meaningful for open_loop_prey\n", source);
+        return false;
+    }
+    return true;
 }
 
-float Protocol::sizeToGL(int size) {
-    return SCREEN_WIDTH_GL * ((float)size / SCREEN_WIDTH_DEG);
+double Protocol::trials(const ProtocolDesign& design) {
+    double trials = design.reps;
+    for (int f = 0; f < FACTOR_TOTAL; ++f) {
+        trials *= design.levels[f];
+    }
+    return trials;
 }
 
-float Protocol::speedToGL(int speed) {
-    return SCREEN_WIDTH_GL * ((float)speed / SCREEN_WIDTH_DEG);
+void Protocol::allocate(int length) {
+    // one block, column after column
+    free(columns_);
+    columns_ = malloc(length * (4 * sizeof(int) + 7 * sizeof(float)));
+    char* p = (char*) columns_;
+    table_.length = length;
+    table_.combination = (int*) p;  p += length * sizeof(int);
+    table_.mode = (int*) p;         p += length * sizeof(int);
+    table_.speed = (float*) p;      p += length * sizeof(float);
+    table_.speed_gl = (float*) p;   p += length * sizeof(float);
+    table_.size = (int*) p;         p += length * sizeof(int);
+    table_.size_gl = (float*) p;    p += length * sizeof(float);
+    table_.gain = (float*) p;       p += length * sizeof(float);
+    table_.frequency = (float*) p;  p += length * sizeof(float);
+    table_.count = (int*) p;        p += length * sizeof(int);
+    table_.duration = (float*) p;   p += length * sizeof(float);
+    table_.inter_trial = (float*) p;
 }
 
-float Protocol::nextGain() {
-    float gain = (gain_index_ < length_) ? gain_array_[gain_index_++] : -1;
-    return gain;
+int Protocol::levelIndex(int factor, int combination) const {
+    return (combination / stride_[factor]) % levels_[factor];
 }
 
-float Protocol::nextSize() {
-    int size = (size_index_ < length_) ? size_array_[size_index_++] : -1;
-    return sizeToGL(size);
+bool Protocol::order(const ProtocolDesign& design, Random& random) {
+    // trials are dealt into equal groups, one per block_by level, or
+    // one per rep of each of those for ORDER_BLOCKS, in one pass
+    int n = table_.length;
+    int reps = design.reps;
+    bool blocks = (design.order == ORDER_BLOCKS);
+    groups_ = (design.block_by >= 0) ? levels_[design.block_by] : 1;
+    groups_ *= blocks ? reps : 1;
+    int size = n / groups_;
+
+    std::vector<int> fill(groups_, 0);
+    int* combination = table_.combination;
+    for (int row = 0; row < n; ++row) {
+        int c = row / reps;
+        int group = (design.block_by >= 0) ? levelIndex(design.block_by, c) : 0;
+        if (blocks) {
+            group = group * reps + row % reps;
+        }
+        combination[group * size + fill[group]++] = c;
+    }
+
+    // then each group is shuffled and its runs limited, and shuffled
+    // again if that gets stuck. runs carry over from group to group
+    int run[FACTOR_TOTAL], level[FACTOR_TOTAL];
+    for (int f = 0; f < FACTOR_TOTAL; ++f) {
+        run[f] = 0;
+        level[f] = -1;
+    }
+    for (int g = 0; g < groups_; ++g) {
+        int* x = combination + g * size;
+        int start_run[FACTOR_TOTAL], start_level[FACTOR_TOTAL];
+        memcpy(start_run, run, sizeof(run));
+        memcpy(start_level, level, sizeof(level));
+
+        bool ok = false;
+        for (int attempt = 0; attempt < 100 && !ok; ++attempt) {
+            if (design.order == ORDER_SEQUENTIAL && attempt > 0) {
+                break; // nothing would change
+            }
+            memcpy(run, start_run, sizeof(run));
+            memcpy(level, start_level, sizeof(level));
+            if (design.order != ORDER_SEQUENTIAL) {
+                for (int i = size - 1; i > 0; --i) {
+                    int j = random.below(i + 1);
+                    int t = x[i];
+                    x[i] = x[j];
+                    x[j] = t;
+                }
+            }
+            ok = limitRuns(design, x, size, run, level);
+        }
+        if (!ok) {
+            return false;
+        }
+    }
+    return true;
 }
 
-float Protocol::nextSpeed() {
-    float speed = (speed_index_ < length_) ? speed_array_[speed_index_++] : -1;
-    return speed;
+bool Protocol::limitRuns(const ProtocolDesign& design, int* x, int n,
+                         int* run, int* level) const {
+    // one pass: a trial that would make any run too long trades places
+    // with the next one that doesn't. in a shuffled group that is
+    // almost always a trial or two ahead, so the pass stays linear
+    for (int i = 0; i < n; ++i) {
+        int j = i;
+        for (; j < n; ++j) {
+            bool fits = true;
+            for (int f = 0; f < FACTOR_TOTAL && fits; ++f) {
+                fits = (design.max_run[f] == 0 || run[f] < design.max_run[f] ||
+                        levelIndex(f, x[j]) != level[f]);
+            }
+            if (fits) {
+                break;
+            }
+        }
+        if (j == n) {
+            return false; // whatever is left would make a run too long
+        }
+        int t = x[i];
+        x[i] = x[j];
+        x[j] = t;
+        for (int f = 0; f < FACTOR_TOTAL; ++f) {
+            int l = levelIndex(f, x[i]);
+            run[f] = (l == level[f]) ? run[f] + 1 : 1;
+            level[f] = l;
+        }
+    }
+    return true;
 }
 
-int Protocol::nextMode() {
-    return (mode_index_ < length_) ? mode_array_[mode_index_++] : -1;
+int Protocol::longestRun(int factor) const {
+    int longest = 0, run = 0, level = -1;
+    for (int i = 0; i < table_.length; ++i) {
+        int l = levelIndex(factor, table_.combination[i]);
+        run = (l == level) ? run + 1 : 1;
+        level = l;
+        longest = (run > longest) ? run : longest;
+    }
+    return longest;
 }
 
-template <typename T> void Protocol::swap(T* a, T* b) {
-    T temp = *a;
-    *a = *b;
-    *b = temp;
+bool Protocol::create(const ProtocolDesign& design, bool saveit, char* path) {
+    // combination c has the last factor listed at level c % levels,
+    // the one before it at (c / levels) % its levels...
+    int combinations = 1;
+    for (int f = 0; f < FACTOR_TOTAL; ++f) {
+        stride_[f] = 1; // only one level
+        levels_[f] = design.levels[f];
+    }
+    for (int k = design.factors - 1; k >= 0; --k) {
+        int f = design.listed[k];
+        stride_[f] = combinations;
+        combinations *= design.levels[f];
+    }
+    int length = combinations * design.reps;
+    allocate(length);
+
+    seed_ = design.seeded ? design.seed : Random::clockSeed();
+    Random random(seed_);
+
+    if (!order(design, random)) {
+        fprintf(stderr, "%s: could not order the trials within the max_run limits\n",
+                design.name);
+        return false;
+    }
+
+    const float (*level)[PROTOCOL_MAX_LEVELS] = design.level;
+    for (int i = 0; i < length; ++i) {
+        int c = table_.combination[i];
+        table_.mode[i] = level[FACTOR_MODE][levelIndex(FACTOR_MODE, c)];
+        table_.speed[i] = level[FACTOR_SPEED][levelIndex(FACTOR_SPEED, c)];
+        table_.size[i] = level[FACTOR_SIZE][levelIndex(FACTOR_SIZE, c)];
+        table_.gain[i] = level[FACTOR_GAIN][levelIndex(FACTOR_GAIN, c)];
+        table_.frequency[i] = level[FACTOR_FREQUENCY][levelIndex(FACTOR_FREQUENCY, c)];
+        table_.count[i] = level[FACTOR_COUNT][levelIndex(FACTOR_COUNT, c)];
+        table_.speed_gl[i] = speedToGL(table_.speed[i]);
+        table_.size_gl[i] = sizeToGL(table_.size[i]);
+        table_.duration[i] = (design.trial_duration > 0) ?
+            design.trial_duration : SCREEN_WIDTH_GL / table_.speed_gl[i];
+        table_.inter_trial[i] = design.inter_trial;
+    }
+
+    if (saveit) {
+        // as text, a double can't hold every 64-bit seed
+        char seed[24];
+        snprintf(seed, sizeof(seed), "%llu", (unsigned long long)seed_);
+
+        RecordFile file;
+        int combination_ch = file.addChannel("combination", RECORD_INT32, 0);
+        int mode_ch = file.addChannel("mode", RECORD_INT32, 0);
+        int speed_ch = file.addChannel("speed", RECORD_FLOAT32, 0);
+        int size_ch = file.addChannel("size", RECORD_INT32, 0);
+        int gain_ch = file.addChannel("gain", RECORD_FLOAT32, 0);
+        int frequency_ch = file.addChannel("frequency", RECORD_FLOAT32, 0);
+        int count_ch = file.addChannel("count", RECORD_INT32, 0);
+        int duration_ch = file.addChannel("duration", RECORD_FLOAT32, 0);
+        file.addParam("protocol", design.name);
+        file.addParam("stimulus", kStimulusNames[design.stimulus]);
+        file.addParam("reps", design.reps);
+        file.addParam("inter_trial", design.inter_trial);
+        file.addParam("order", kOrderNames[design.order]);
+        file.addParam("block_by", (design.block_by >= 0) ? kFactorNames[design.block_by] : "none");
+        file.addParam("seed", seed);
+        if (!file.open(path)) {
+            return false;
+        }
+        file.append(combination_ch, table_.combination, length);
+        file.append(mode_ch, table_.mode, length);
+        file.append(speed_ch, table_.speed, length);
+        file.append(size_ch, table_.size, length);
+        file.append(gain_ch, table_.gain, length);
+        file.append(frequency_ch, table_.frequency, length);
+        file.append(count_ch, table_.count, length);
+        file.append(duration_ch, table_.duration, length);
+        if (!file.close()) {
+            return false;
+        }
+    }
+    return true;
 }
 
-template <typename T> void Protocol::shuffle(T* x) {
-    int i, ri;
-    for (i = 0; i < length_; ++i) {
-        ri = (rand() % (length_ - i)) + i;
-        swap(x + i, x + ri);
+bool Protocol::check(const ProtocolDesign& design) const {
+    int combinations = table_.length / design.reps;
+    int size = table_.length / groups_;
+    int per_level = groups_ / ((design.block_by >= 0) ? design.levels[design.block_by] : 1);
+    std::vector<int> seen(combinations, 0);
+    std::vector<int> in_block(combinations, -1);
+    for (int i = 0; i < table_.length; ++i) {
+        int c = table_.combination[i];
+        int g = i / size;
+        if (c < 0 || c >= combinations || ++seen[c] > design.reps) {
+            return false;
+        }
+        if (design.block_by >= 0 && levelIndex(design.block_by, c) != g / per_level) {
+            return false; // out of its level's block
+        }
+        if (design.order == ORDER_BLOCKS) {
+            if (in_block[c] == g) {
+                return false; // twice in one block
+            }
+            in_block[c] = g;
+        }
+    }
+    for (int f = 0; f < FACTOR_TOTAL; ++f) {
+        if (design.max_run[f] > 0 && longestRun(f) > design.max_run[f]) {
+            return false;
+        }
     }
+    return true;
+}
+
+const TrialTable& Protocol::table() const {
+    return table_;
+}
+
+int Protocol::length() const {
+    return table_.length;
+}
+
+uint64_t Protocol::seed() const {
+    return seed_;
+}
+
+float Protocol::sizeToGL(float size) {
+    return SCREEN_WIDTH_GL * (size / SCREEN_WIDTH_DEG);
+}
+
+float Protocol::speedToGL(float speed) {
+    return SCREEN_WIDTH_GL * (speed / SCREEN_WIDTH_DEG);
 }
@@ -4,14 +4,108 @@
 #include <ctime>
 #include <cstdlib>
 #include <cstdio>
+#include <stdint.h>
 
 #define SCREEN_WIDTH_GL 0.7 //0.68
 #define SCREEN_WIDTH_DEG 200
 
+class Random;
+
 #define OPEN_LOOP_OMR 0
 #define OPEN_LOOP_PREY 1
 #define CLOSED_LOOP_OMR 2
 #define CLOSED_LOOP_PREY 3
+#define OPEN_LOOP_GRATING_SWEEP 4
+#define OPEN_LOOP_PREY_SWARM 5
+
+// trial parameters a protocol can vary
+enum PROTOCOL_FACTOR {
+    FACTOR_MODE,      // 0 rightward, 1 leftward, 2 forward
+    FACTOR_SPEED,     // deg / s
+    FACTOR_SIZE,      // deg
+    FACTOR_GAIN,      // closed-loop feedback gain
+    FACTOR_FREQUENCY, // cycles / deg
+    FACTOR_COUNT,     // dots per swarm
+    FACTOR_TOTAL
+};
+
+#define PROTOCOL_MAX_LEVELS 64
+#define PROTOCOL_MAX_TRIALS (1 << 24)
+
+// how trials are ordered
+enum PROTOCOL_ORDER {
+    ORDER_SEQUENTIAL, // as listed
+    ORDER_RANDOM,     // shuffled within each block_by level
+    ORDER_BLOCKS      // each rep is a block holding every combination once
+};
+
+/* An experimental design, as read from a protocol file:
+
+     # comments run to the end of the line
+     name open_loop_prey
+     stimulus open_loop_prey
+     factor speed 30 60 90 120 150
+     factor size 1 3 5 7 20 30
+     reps 5
+     trial_duration 0
+     inter_trial 10
+     order blocks
+     max_run size 2
+     seed 1234
+
+ Every combination of the factors' levels is run reps times, the first
+ factor listed varying slowest. Factors that aren't listed keep a
+ single default level. stimulus is one of open_loop_omr,
+ open_loop_prey, closed_loop_omr, grating_sweep and prey_swarm, and
+ must match the experiment type being run. Durations are in seconds; a
+ trial_duration of 0 runs each prey trial until it has crossed the
+ screen.
+
+ Whole trials are reordered, so factor levels stay paired as designed.
+ order is sequential, random (the default) or blocks, where every rep
+ is a block running each combination once. block_by holds one factor
+ at each of its levels in turn, in the order listed, and orders the
+ trials within. max_run caps how many trials in a row may share a
+ factor's level. Without a seed, one is taken from the clock; either
+ way it is saved with the trial table.
+ */
+typedef struct ProtocolDesign {
+    char name[64];
+    int stimulus; // experiment type
+    int factors;  // varied, in the order listed
+    int listed[FACTOR_TOTAL];
+    int levels[FACTOR_TOTAL];
+    float level[FACTOR_TOTAL][PROTOCOL_MAX_LEVELS];
+    int reps;
+    float trial_duration;
+    float inter_trial;
+    int order;
+    int block_by;              // factor, -1 for none
+    int max_run[FACTOR_TOTAL]; // 0 for no limit
+    bool seeded;
+    uint64_t seed;
+} ProtocolDesign;
+
+/* Every trial of a protocol, one column per parameter, with GL units
+ worked out ahead of time. The columns share one allocation, so the
+ frame loop only ever reads table.speed_gl[trial] and so on.
+ combination numbers each trial's combination of levels, in the order
+ the design lists them.
+ */
+typedef struct TrialTable {
+    int length;
+    int* combination;
+    int* mode;
+    float* speed;
+    float* speed_gl;
+    int* size;
+    float* size_gl;
+    float* gain;
+    float* frequency;
+    int* count;
+    float* duration;
+    float* inter_trial;
+} TrialTable;
 
 class Protocol
 {
@@ -19,35 +113,49 @@ public:
     Protocol();
     ~Protocol();
     
-    int experiment_type_;
+    // the design a protocol file describes, false with the reason on
+    // stderr if it can't be read or doesn't make sense
+    static bool load(const char* path, ProtocolDesign* design);
+    // the design compiled in for an experiment type
+    static bool builtin(int experiment_type, ProtocolDesign* design);
+    
+    static double trials(const ProtocolDesign& design);
     
-    void createOpenLoopStepOMR(bool saveit, char* path);
-    void createClosedLoopStepOMR(bool saveit, char* path);
-    void createOpenLoopPrey(bool saveit, char* path);
+    // expands a design into the trial table, optionally saving it.
+    // false if its max_run limits couldn't be met or the table
+    // couldn't be saved
+    bool create(const ProtocolDesign& design, bool saveit, char* path);
+    // whether the table holds every combination reps times, in the
+    // blocks and within the run lengths its design asks for
+    bool check(const ProtocolDesign& design) const;
     
-    float nextSize();
-    float nextSpeed();
-    int nextMode();
-    float nextGain();
-    void reset();
+    const TrialTable& table() const;
+    int length() const;
+    uint64_t seed() const; // the table was ordered with this
     
-    float sizeToGL(int size);
-    float speedToGL(int speed);
+    static float sizeToGL(float size);
+    static float speedToGL(float speed);
     
 private:
-    int* size_array_;
-    float* speed_array_;
-    int* mode_array_;
-    float* gain_array_;
-    int length_;
-    
-    int size_index_;
-    int speed_index_;
-    int mode_index_;
-    int gain_index_;
-    
-    template <typename T> void shuffle(T* x);
-    template <typename T> void swap(T* a, T* b);
+    static bool parse(const char* text, const char* source, ProtocolDesign* design);
+    static bool validate(const ProtocolDesign& design, const char* source);
+    void allocate(int length);
+    bool order(const ProtocolDesign& design, Random& random);
+    bool limitRuns(const ProtocolDesign& design, int* x, int n, int* run, int* level) const;
+    int longestRun(int factor) const;
+    int levelIndex(int factor, int combination) const;
+    
+    TrialTable table_;
+    void* columns_;
+    uint64_t seed_;
+    
+    // decode a combination number into each factor's level
+    int stride_[FACTOR_TOTAL];
+    int levels_[FACTOR_TOTAL];
+    int groups_; // blocks the table is split into, all the same length
+    
+    Protocol(const Protocol&);
+    Protocol& operator=(const Protocol&);
 };
 
 #endif
@@ -0,0 +1,55 @@
+#include "Random.h"
+#include <ctime>
+
+static uint64_t splitmix64(uint64_t* x) {
+    uint64_t z = (*x += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+static inline uint64_t rotl(uint64_t x, int k) {
+    return (x << k) | (x >> (64 - k));
+}
+
+Random::Random(uint64_t seed) {
+    for (int i = 0; i < 4; ++i) {
+        s_[i] = splitmix64(&seed);
+    }
+}
+
+uint64_t Random::next() {
+    uint64_t result = rotl(s_[1] * 5, 7) * 9;
+    uint64_t t = s_[1] << 17;
+    s_[2] ^= s_[0];
+    s_[3] ^= s_[1];
+    s_[1] ^= s_[2];
+    s_[0] ^= s_[3];
+    s_[2] ^= t;
+    s_[3] = rotl(s_[3], 45);
+    return result;
+}
+
+uint32_t Random::below(uint32_t n) {
+    // Lemire's multiply-shift: the high word of a 32 x 32 bit product
+    // is uniform once the few low words that would bias it are
+    // rejected, which almost never needs a division
+    uint64_t m = (uint64_t)(uint32_t)(next() >> 32) * n;
+    uint32_t low = (uint32_t)m;
+    if (low < n) {
+        uint32_t threshold = -n % n;
+        while (low < threshold) {
+            m = (uint64_t)(uint32_t)(next() >> 32) * n;
+            low = (uint32_t)m;
+        }
+    }
+    return m >> 32;
+}
+
+uint64_t Random::clockSeed() {
+    static uint64_t calls = 0;
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    uint64_t x = ((uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec) ^ (++calls << 48);
+    return splitmix64(&x);
+}
@@ -0,0 +1,26 @@
+#ifndef RANDOM_H
+#define RANDOM_H
+
+#include <stdint.h>
+
+/* Small, fast, seedable generator (xoshiro256**) for trial orders.
+ The state is expanded from a single 64-bit seed with splitmix64, so
+ nearby seeds give unrelated sequences and recording the seed is
+ enough to regenerate a session's protocol exactly.
+ */
+class Random
+{
+public:
+    explicit Random(uint64_t seed);
+
+    uint64_t next();
+    uint32_t below(uint32_t n); // uniform in [0, n), without modulo bias
+
+    // a different seed on every call, from the clock and a counter
+    static uint64_t clockSeed();
+
+private:
+    uint64_t s_[4];
+};
+
+#endif
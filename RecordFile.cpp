@@ -0,0 +1,326 @@
+#include "RecordFile.h"
+#include <cerrno>
+#include <cstring>
+#include "RiceCodec.h"
+
+static const uint32_t kRecordVersion = 2;
+
+int recordTypeSize(RecordType type) {
+    switch (type) {
+        case RECORD_UINT8:
+            return 1;
+        case RECORD_INT32:
+        case RECORD_FLOAT32:
+            return 4;
+        case RECORD_FLOAT64:
+            return 8;
+    }
+    return 0;
+}
+
+const char* recordTypeName(RecordType type) {
+    // numpy dtype strings
+    switch (type) {
+        case RECORD_UINT8:
+            return "|u1";
+        case RECORD_INT32:
+            return "<i4";
+        case RECORD_FLOAT32:
+            return "<f4";
+        case RECORD_FLOAT64:
+            return "<f8";
+    }
+    return "";
+}
+
+RecordFile::RecordFile(int chunk_samples, int pool_blocks)
+    : file_(NULL), error_(0), chunk_samples_(chunk_samples), pool_blocks_(pool_blocks),
+      realtime_(false), queue_head_(0), queue_size_(0), stopping_(false) {
+}
+
+RecordFile::~RecordFile() {
+    close();
+}
+
+int RecordFile::addChannel(const char* name, RecordType type, double sample_rate,
+                           int chunk_samples) {
+    Channel c;
+    c.name = name;
+    c.type = type;
+    c.sample_rate = sample_rate;
+    c.chunk_samples = (chunk_samples > 0) ? chunk_samples : chunk_samples_;
+    c.current = NULL;
+    c.count = 0;
+    c.dropped = 0;
+    c.compressed = false;
+    channels_.push_back(c);
+    return channels_.size() - 1;
+}
+
+void RecordFile::addParam(const char* key, const char* value) {
+    params_ += "param ";
+    params_ += key;
+    params_ += " ";
+    params_ += value;
+    params_ += "\n";
+}
+
+void RecordFile::addParam(const char* key, double value) {
+    char str[64];
+    snprintf(str, sizeof(str), "%.9g", value);
+    addParam(key, str);
+}
+
+void RecordFile::setRealtime(bool realtime) {
+    realtime_ = realtime;
+}
+
+void RecordFile::compress(int channel) {
+    if (channels_[channel].type == RECORD_UINT8) {
+        channels_[channel].compressed = true;
+    }
+}
+
+bool RecordFile::open(const char* path) {
+    file_ = fopen(path, "wb");
+    if (!file_) {
+        perror(path);
+        return false;
+    }
+    path_ = path;
+    error_ = 0;
+
+    std::string header;
+    char line[256];
+    size_t scratch_bytes = 0;
+    for (unsigned int i = 0; i < channels_.size(); ++i) {
+        Channel& c = channels_[i];
+        snprintf(line, sizeof(line), "channel %u %s %s %.9g %s\n", i, c.name.c_str(),
+                 recordTypeName(c.type), c.sample_rate, c.compressed ? "rice" : "raw");
+        header += line;
+
+        if (c.compressed && riceBound(c.chunk_samples) > scratch_bytes) {
+            scratch_bytes = riceBound(c.chunk_samples);
+        }
+        c.raw_bytes = 0;
+        c.stored_bytes = 0;
+
+        // allocate the block pool up front, nothing is allocated while recording
+        int block_bytes = c.chunk_samples * recordTypeSize(c.type);
+        c.storage.resize(pool_blocks_ * block_bytes);
+        c.free.clear();
+        for (int b = 0; b < pool_blocks_; ++b) {
+            c.free.push_back(&c.storage[b * block_bytes]);
+        }
+        c.current = NULL;
+        c.count = 0;
+        c.dropped = 0;
+    }
+    scratch_.resize(scratch_bytes);
+    header += params_;
+    while (header.size() % 8) {
+        header += " ";
+    }
+
+    uint32_t version = kRecordVersion;
+    uint32_t header_bytes = header.size();
+    write("VREC", 4);
+    write(&version, sizeof(version));
+    write(&header_bytes, sizeof(header_bytes));
+    write(header.data(), header.size());
+    if (fflush(file_) != 0 && !error_) {
+        error_ = errno;
+    }
+
+    queue_.resize(channels_.size() * pool_blocks_);
+    queue_head_ = 0;
+    queue_size_ = 0;
+    stopping_ = false;
+    writer_ = std::thread(&RecordFile::run, this);
+    return true;
+}
+
+bool RecordFile::isOpen() const {
+    return file_ != NULL;
+}
+
+bool RecordFile::close() {
+    if (!file_) {
+        return false;
+    }
+    flush();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    work_cv_.notify_one();
+    writer_.join();
+
+    if (fclose(file_) != 0 && !error_) {
+        error_ = errno;
+    }
+    file_ = NULL;
+    if (error_) {
+        fprintf(stderr, "%s: %s, the recording is incomplete\n",
+                path_.c_str(), strerror(error_));
+    }
+
+    for (unsigned int i = 0; i < channels_.size(); ++i) {
+        Channel& c = channels_[i];
+        if (c.dropped > 0) {
+            fprintf(stderr, "recording dropped %lu samples of %s\n",
+                    c.dropped, c.name.c_str());
+        }
+        if (c.compressed && c.stored_bytes > 0) {
+            printf("%s: %llu bytes stored as %llu (%.2fx)\n", c.name.c_str(),
+                   c.raw_bytes, c.stored_bytes, (double)c.raw_bytes / c.stored_bytes);
+        }
+    }
+    return error_ == 0;
+}
+
+void RecordFile::append(int channel, const void* data, int count) {
+    if (!file_) {
+        return;
+    }
+    Channel& c = channels_[channel];
+    int size = recordTypeSize(c.type);
+    const uint8_t* src = (const uint8_t*)data;
+
+    while (count > 0) {
+        if (!c.current) {
+            c.current = takeBlock(channel);
+            if (!c.current) {
+                // writer is behind and the pool is empty
+                c.dropped += count;
+                return;
+            }
+        }
+
+        int n = c.chunk_samples - c.count;
+        if (n > count) {
+            n = count;
+        }
+        memcpy(c.current + c.count * size, src, n * size);
+        c.count += n;
+        src += n * size;
+        count -= n;
+
+        if (c.count == c.chunk_samples) {
+            submit(channel);
+        }
+    }
+}
+
+void RecordFile::append(int channel, float x) {
+    append(channel, &x, 1);
+}
+
+void RecordFile::append(int channel, double x) {
+    append(channel, &x, 1);
+}
+
+void RecordFile::flush() {
+    if (!file_) {
+        return;
+    }
+    for (unsigned int i = 0; i < channels_.size(); ++i) {
+        if (channels_[i].count > 0) {
+            submit(i);
+        }
+    }
+}
+
+unsigned long RecordFile::dropped() const {
+    unsigned long n = 0;
+    for (unsigned int i = 0; i < channels_.size(); ++i) {
+        n += channels_[i].dropped;
+    }
+    return n;
+}
+
+uint8_t* RecordFile::takeBlock(int channel) {
+    Channel& c = channels_[channel];
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (c.free.empty()) {
+        if (realtime_) {
+            return NULL;
+        }
+        free_cv_.wait(lock, [&c] { return !c.free.empty(); });
+    }
+    uint8_t* block = c.free.back();
+    c.free.pop_back();
+    return block;
+}
+
+void RecordFile::submit(int channel) {
+    Channel& c = channels_[channel];
+    Block b;
+    b.channel = channel;
+    b.count = c.count;
+    b.data = c.current;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        queue_[(queue_head_ + queue_size_) % queue_.size()] = b;
+        queue_size_++;
+    }
+    work_cv_.notify_one();
+    c.current = NULL;
+    c.count = 0;
+}
+
+void RecordFile::run() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        work_cv_.wait(lock, [this] { return queue_size_ > 0 || stopping_; });
+        if (queue_size_ == 0) {
+            break; // stopping and nothing left to write
+        }
+        Block b = queue_[queue_head_];
+        queue_head_ = (queue_head_ + 1) % queue_.size();
+        queue_size_--;
+
+        lock.unlock();
+        writeChunk(b.channel, b.data, b.count);
+        lock.lock();
+
+        channels_[b.channel].free.push_back(b.data);
+        free_cv_.notify_one();
+    }
+}
+
+void RecordFile::writeChunk(int channel, const uint8_t* data, int count) {
+    Channel& c = channels_[channel];
+    uint32_t head[3];
+    head[0] = channel;
+    head[1] = count;
+    head[2] = count * recordTypeSize(c.type);
+    c.raw_bytes += head[2];
+
+    if (c.compressed) {
+        head[2] = riceEncode(data, count, &scratch_[0]);
+        data = &scratch_[0];
+    }
+    c.stored_bytes += head[2];
+
+    write("CHNK", 4);
+    write(head, 3 * sizeof(uint32_t));
+    write(data, head[2]);
+
+    static const uint8_t zeros[8] = {0};
+    write(zeros, (8 - head[2] % 8) % 8);
+    if (fflush(file_) != 0 && !error_) {
+        error_ = errno;
+    }
+}
+
+void RecordFile::write(const void* data, size_t n) {
+    // once a write has failed the file can't be parsed past it, so
+    // stop and keep the first error for close()
+    if (error_ || n == 0) {
+        return;
+    }
+    if (fwrite(data, 1, n, file_) != n) {
+        error_ = errno ? errno : EIO;
+    }
+}
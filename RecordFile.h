@@ -0,0 +1,137 @@
+#ifndef RECORD_FILE_H
+#define RECORD_FILE_H
+
+#include <stdint.h>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+/* Chunked binary recording file (.vrec).
+
+ Layout, all integers little-endian:
+
+   "VREC" | uint32 version | uint32 header_bytes | header text
+   chunk*
+
+ The header text is ASCII, one declaration per line, padded with
+ spaces to a multiple of 8 bytes:
+
+   channel <id> <name> <numpy dtype> <sample rate, 0 if irregular> <codec>
+   param <key> <value>
+
+ Each chunk is
+
+   "CHNK" | uint32 channel | uint32 count | uint32 bytes | data
+
+ where data is `count` samples of the channel's dtype, zero-padded to
+ a multiple of 8 bytes. Concatenating a channel's chunks gives its
+ full record. For "raw" channels each payload can be handed straight
+ to numpy.frombuffer() on a memory-mapped file (see load_vrec.py).
+ "rice" channels hold 8-bit samples packed with riceEncode(), one
+ self-contained block per chunk; vrec_decode expands them back to raw.
+
+ append() only copies samples into a block from a fixed per-channel
+ pool. Full blocks are queued to a writer thread, which writes and
+ flushes them as chunks, so the caller never touches the filesystem
+ and memory use doesn't grow with session length. In realtime mode
+ append() never waits: if the writer falls behind and a channel runs
+ out of blocks, samples are dropped and counted instead. append() and
+ flush() must all be called from the same thread. Compression of
+ "rice" channels also happens on the writer thread. The first failed
+ write (a full disk, say) stops all further writing and is reported by
+ close(), since the rest of the file couldn't be parsed past it.
+ */
+
+enum RecordType {
+    RECORD_UINT8,
+    RECORD_INT32,
+    RECORD_FLOAT32,
+    RECORD_FLOAT64
+};
+
+class RecordFile
+{
+public:
+    RecordFile(int chunk_samples = 4096, int pool_blocks = 8);
+    ~RecordFile();
+
+    // declare the layout before open(). chunk_samples of 0 uses the default
+    int addChannel(const char* name, RecordType type, double sample_rate,
+                   int chunk_samples = 0);
+    void addParam(const char* key, const char* value);
+    void addParam(const char* key, double value);
+    void setRealtime(bool realtime);
+    void compress(int channel); // delta/Rice code a RECORD_UINT8 channel
+
+    bool open(const char* path);
+    bool isOpen() const;
+    bool close(); // false if anything failed to reach the file
+
+    void append(int channel, const void* data, int count);
+    void append(int channel, float x);
+    void append(int channel, double x);
+    void flush(); // hand partially filled blocks to the writer
+
+    unsigned long dropped() const;
+
+private:
+    typedef struct Channel {
+        std::string name;
+        RecordType type;
+        double sample_rate;
+        int chunk_samples;
+
+        std::vector<uint8_t> storage; // pool_blocks_ blocks of chunk_samples
+        std::vector<uint8_t*> free; // guarded by mutex_
+        uint8_t* current; // block being filled, owned by the producer
+        int count;
+        unsigned long dropped;
+
+        bool compressed;
+        unsigned long long raw_bytes; // written by the writer thread
+        unsigned long long stored_bytes;
+    } Channel;
+
+    typedef struct Block {
+        int channel;
+        int count;
+        uint8_t* data;
+    } Block;
+
+    uint8_t* takeBlock(int channel);
+    void submit(int channel);
+    void run();
+    void writeChunk(int channel, const uint8_t* data, int count);
+    void write(const void* data, size_t n);
+
+    FILE* file_;
+    std::string path_;
+    int error_; // errno of the first failed write, 0 if none. writer thread
+                // only between open() and close()
+    int chunk_samples_;
+    int pool_blocks_;
+    bool realtime_;
+    std::vector<Channel> channels_;
+    std::string params_;
+
+    std::vector<uint8_t> scratch_; // compressed chunk, writer thread only
+    std::thread writer_;
+    std::mutex mutex_;
+    std::condition_variable work_cv_; // signals a block was queued
+    std::condition_variable free_cv_; // signals a block was returned
+    std::vector<Block> queue_; // fixed ring, one slot per block in the pools
+    int queue_head_;
+    int queue_size_;
+    bool stopping_;
+
+    RecordFile(const RecordFile&);
+    RecordFile& operator=(const RecordFile&);
+};
+
+int recordTypeSize(RecordType type);
+const char* recordTypeName(RecordType type);
+
+#endif
@@ -0,0 +1,252 @@
+#include "Renderer.h"
+#include <cstdio>
+#include <cstddef>
+#include <cstring>
+#include <cstdlib>
+#include <algorithm>
+#include <cmath>
+
+Renderer::Renderer(int max_vertices, int max_indices)
+    : max_vertices_(max_vertices), max_indices_(max_indices),
+      vao_(0), vertex_buffer_(0), index_buffer_(0), transform_buffer_(0),
+      modulation_buffer_(0) {
+    vertices_.reserve(max_vertices);
+    indices_.reserve(max_indices);
+    meshes_.reserve(RENDERER_MAX_OBJECTS);
+    vertex_slots_.reserve(RENDERER_MAX_OBJECTS);
+    index_slots_.reserve(RENDERER_MAX_OBJECTS);
+    index_counts_.reserve(RENDERER_MAX_OBJECTS);
+    queue_.reserve(RENDERER_MAX_OBJECTS);
+    transforms_.resize(16 * RENDERER_MAX_OBJECTS);
+    modulations_.resize(8 * RENDERER_MAX_OBJECTS);
+    means_.resize(3 * RENDERER_MAX_OBJECTS);
+    programs_.reserve(RENDERER_MAX_OBJECTS);
+    counts_.resize(RENDERER_MAX_OBJECTS);
+    offsets_.resize(RENDERER_MAX_OBJECTS);
+    base_vertices_.resize(RENDERER_MAX_OBJECTS);
+}
+
+Renderer::~Renderer() {
+}
+
+void Renderer::init() {
+    glGenVertexArrays(1, &vao_);
+    glGenBuffers(1, &vertex_buffer_);
+    glGenBuffers(1, &index_buffer_);
+    glGenBuffers(1, &transform_buffer_);
+    glGenBuffers(1, &modulation_buffer_);
+
+    glBindVertexArray(vao_);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, index_buffer_);
+    glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer_);
+
+    glEnableVertexAttribArray(VERTEX_POSITION);
+    glVertexAttribPointer(VERTEX_POSITION, 2, GL_FLOAT, GL_FALSE,
+                          sizeof(ArenaVertex),
+                          (const GLvoid*) offsetof(ArenaVertex, position));
+
+    glEnableVertexAttribArray(VERTEX_COLOR);
+    glVertexAttribPointer(VERTEX_COLOR, 4, GL_UNSIGNED_BYTE, GL_FALSE,
+                          sizeof(ArenaVertex),
+                          (const GLvoid*) offsetof(ArenaVertex, color));
+
+    glEnableVertexAttribArray(VERTEX_OBJECT);
+    glVertexAttribIPointer(VERTEX_OBJECT, 1, GL_UNSIGNED_INT,
+                           sizeof(ArenaVertex),
+                           (const GLvoid*) offsetof(ArenaVertex, object));
+
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    glBindBuffer(GL_UNIFORM_BUFFER, transform_buffer_);
+    glBufferData(GL_UNIFORM_BUFFER, transforms_.size() * sizeof(GLfloat),
+                 NULL, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, modulation_buffer_);
+    glBufferData(GL_UNIFORM_BUFFER, modulations_.size() * sizeof(GLfloat),
+                 NULL, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    glBindBufferBase(GL_UNIFORM_BUFFER, RENDERER_TRANSFORMS_BINDING, transform_buffer_);
+    glBindBufferBase(GL_UNIFORM_BUFFER, RENDERER_MODULATIONS_BINDING, modulation_buffer_);
+}
+
+void Renderer::add(Mesh* mesh) {
+    if (mesh->object_ >= 0) {
+        return; // already in the arena
+    }
+    int vertex_slot = std::max(mesh->num_vertices_, mesh->vertex_capacity_);
+    int index_slot = std::max(mesh->num_indices_, mesh->index_capacity_);
+    if ((int)meshes_.size() == RENDERER_MAX_OBJECTS ||
+        (int)vertices_.size() + vertex_slot > max_vertices_ ||
+        (int)indices_.size() + index_slot > max_indices_) {
+        fprintf(stderr, "renderer arena is full\n");
+        exit(EXIT_FAILURE);
+    }
+
+    mesh->object_ = meshes_.size();
+    mesh->base_vertex_ = vertices_.size();
+    mesh->first_index_ = indices_.size();
+    meshes_.push_back(mesh);
+    vertex_slots_.push_back(vertex_slot);
+    index_slots_.push_back(index_slot);
+    index_counts_.push_back(0);
+
+    vertices_.resize(vertices_.size() + vertex_slot);
+    indices_.resize(indices_.size() + index_slot);
+    copy(mesh);
+}
+
+void Renderer::copy(Mesh* mesh) {
+    for (int i = 0; i < mesh->num_vertices_; ++i) {
+        ArenaVertex& v = vertices_[mesh->base_vertex_ + i];
+        v.position[0] = mesh->vertices_[i].position[0];
+        v.position[1] = mesh->vertices_[i].position[1];
+        for (int c = 0; c < 4; ++c) {
+            v.color[c] = mesh->vertices_[i].color[c];
+        }
+        v.object = mesh->object_;
+    }
+    memcpy(&indices_[mesh->first_index_], mesh->indices_,
+           mesh->num_indices_ * sizeof(GLushort));
+    index_counts_[mesh->object_] = mesh->num_indices_;
+
+    // contrast is taken about the color the mesh averages to on screen:
+    // each triangle is flat shaded with its last vertex's color, so
+    // weight that color by the triangle's area
+    double sum[3] = {0, 0, 0};
+    double total = 0;
+    for (int i = 0; i + 2 < mesh->num_indices_; i += 3) {
+        const Vertex2D& a = mesh->vertices_[mesh->indices_[i]];
+        const Vertex2D& b = mesh->vertices_[mesh->indices_[i + 1]];
+        const Vertex2D& c = mesh->vertices_[mesh->indices_[i + 2]];
+        double area = 0.5 * fabs((b.position[0] - a.position[0]) * (c.position[1] - a.position[1]) -
+                                 (c.position[0] - a.position[0]) * (b.position[1] - a.position[1]));
+        for (int k = 0; k < 3; ++k) {
+            sum[k] += area * c.color[k];
+        }
+        total += area;
+    }
+    for (int k = 0; k < 3; ++k) {
+        means_[3 * mesh->object_ + k] = (total > 0) ? sum[k] / (255 * total) : 0;
+    }
+}
+
+void Renderer::upload() {
+    glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer_);
+    glBufferData(GL_ARRAY_BUFFER, vertices_.size() * sizeof(ArenaVertex),
+                 vertices_.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    // the index buffer binding is part of the VAO
+    glBindVertexArray(vao_);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices_.size() * sizeof(GLushort),
+                 indices_.data(), GL_STATIC_DRAW);
+    glBindVertexArray(0);
+}
+
+bool Renderer::update(Mesh* mesh) {
+    if (mesh->object_ < 0) {
+        return false;
+    }
+    if (mesh->num_vertices_ > vertex_slots_[mesh->object_] ||
+        mesh->num_indices_ > index_slots_[mesh->object_]) {
+        fprintf(stderr, "mesh %d outgrew its arena slot, reserve() it before add()\n",
+                mesh->object_);
+        return false;
+    }
+    copy(mesh);
+
+    glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer_);
+    glBufferSubData(GL_ARRAY_BUFFER, mesh->base_vertex_ * sizeof(ArenaVertex),
+                    mesh->num_vertices_ * sizeof(ArenaVertex),
+                    &vertices_[mesh->base_vertex_]);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    glBindVertexArray(vao_);
+    glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, mesh->first_index_ * sizeof(GLushort),
+                    mesh->num_indices_ * sizeof(GLushort),
+                    &indices_[mesh->first_index_]);
+    glBindVertexArray(0);
+    return true;
+}
+
+void Renderer::bindProgram(GLuint program) {
+    GLuint block = glGetUniformBlockIndex(program, "Transforms");
+    if (block != GL_INVALID_INDEX) {
+        glUniformBlockBinding(program, block, RENDERER_TRANSFORMS_BINDING);
+    }
+    block = glGetUniformBlockIndex(program, "Modulations");
+    if (block != GL_INVALID_INDEX) {
+        glUniformBlockBinding(program, block, RENDERER_MODULATIONS_BINDING);
+    }
+}
+
+void Renderer::draw(Mesh* mesh) {
+    if (mesh->object_ >= 0 && (int)queue_.size() < RENDERER_MAX_OBJECTS) {
+        queue_.push_back(mesh);
+    }
+}
+
+void Renderer::flush() {
+    if (queue_.empty()) {
+        return;
+    }
+
+    // one update covering every queued object's transform, one for
+    // their modulation
+    int top = 0;
+    programs_.clear();
+    for (unsigned int i = 0; i < queue_.size(); ++i) {
+        Mesh* mesh = queue_[i];
+        memcpy(&transforms_[16 * mesh->object_], mesh->transform_matrix_,
+               16 * sizeof(GLfloat));
+
+        GLfloat* m = &modulations_[8 * mesh->object_];
+        for (int k = 0; k < 3; ++k) {
+            m[k] = mesh->tint_[k] * mesh->luminance_;
+            m[4 + k] = means_[3 * mesh->object_ + k];
+        }
+        m[3] = mesh->tint_[3];
+        m[7] = mesh->contrast_;
+        top = (mesh->object_ + 1 > top) ? mesh->object_ + 1 : top;
+
+        unsigned int p = 0;
+        while (p < programs_.size() && programs_[p] != mesh->program_) {
+            p++;
+        }
+        if (p == programs_.size()) {
+            programs_.push_back(mesh->program_);
+        }
+    }
+    glBindBuffer(GL_UNIFORM_BUFFER, transform_buffer_);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, 16 * top * sizeof(GLfloat),
+                    transforms_.data());
+    glBindBuffer(GL_UNIFORM_BUFFER, modulation_buffer_);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, 8 * top * sizeof(GLfloat),
+                    modulations_.data());
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+    glBindVertexArray(vao_);
+    for (unsigned int p = 0; p < programs_.size(); ++p) {
+        int n = 0;
+        for (unsigned int i = 0; i < queue_.size(); ++i) {
+            Mesh* mesh = queue_[i];
+            if (mesh->program_ != programs_[p]) {
+                continue;
+            }
+            counts_[n] = index_counts_[mesh->object_];
+            offsets_[n] = (GLvoid*)(mesh->first_index_ * sizeof(GLushort));
+            base_vertices_[n] = mesh->base_vertex_;
+            n++;
+        }
+        glUseProgram(programs_[p]);
+        glMultiDrawElementsBaseVertex(GL_TRIANGLES, counts_.data(), GL_UNSIGNED_SHORT,
+                                      offsets_.data(), n, base_vertices_.data());
+    }
+    glBindVertexArray(0);
+
+    queue_.clear();
+}
+
+int Renderer::objects() const {
+    return meshes_.size();
+}
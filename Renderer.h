@@ -0,0 +1,99 @@
+#ifndef RENDERER_H
+#define RENDERER_H
+
+#include <GL/glew.h>
+#include <stdint.h>
+#include <vector>
+#include "Mesh.h"
+
+// must match the size of the Transforms and Modulations blocks in the
+// vertex shaders
+#define RENDERER_MAX_OBJECTS 256
+
+// uniform buffer binding points
+#define RENDERER_TRANSFORMS_BINDING 0
+#define RENDERER_MODULATIONS_BINDING 1
+
+enum ATTRIBUTE_ID {
+    VERTEX_POSITION,
+    VERTEX_COLOR,
+    VERTEX_OBJECT
+};
+
+// a mesh vertex as stored in the arena, tagged with its mesh's object id
+typedef struct ArenaVertex {
+    float position[2];
+    uint8_t color[4];
+    uint32_t object;
+} ArenaVertex;
+
+/* Draws every mesh out of one shared vertex/index arena.
+
+ add() copies a mesh's geometry into the arena and gives it an
+ object id; upload() sends the arena to the GPU. Each vertex carries
+ its object id, and the shaders look up their transform in a uniform
+ block holding every object's matrix, so nothing has to be rebound
+ between meshes.
+
+ A mesh gets a slot in the arena as large as its reserved capacity.
+ After rebuilding or recoloring it, update() rewrites that slot in
+ place with glBufferSubData, so geometry can change between trials
+ without new GL objects or any allocation.
+
+ Each frame, draw() queues meshes and flush() uploads their
+ transforms, and their tint, contrast and luminance in a second
+ block, with one buffer update each, then issues one
+ glMultiDrawElementsBaseVertex per program, in the order each program
+ was first queued.
+ */
+class Renderer
+{
+public:
+    Renderer(int max_vertices, int max_indices);
+    ~Renderer();
+
+    void init(); // needs a current GL context
+
+    void add(Mesh* mesh);
+    void upload();
+    bool update(Mesh* mesh); // false if it outgrew its slot
+    void bindProgram(GLuint program); // point its uniform blocks at our buffers
+
+    void draw(Mesh* mesh);
+    void flush();
+
+    int objects() const;
+
+private:
+    void copy(Mesh* mesh);
+
+    int max_vertices_;
+    int max_indices_;
+    std::vector<ArenaVertex> vertices_;
+    std::vector<GLushort> indices_;
+    std::vector<Mesh*> meshes_; // by object id
+    std::vector<int> vertex_slots_; // arena room for each object
+    std::vector<int> index_slots_;
+    std::vector<GLsizei> index_counts_; // as of the last add() or update()
+    std::vector<GLfloat> means_; // mean rgb of each object, 0-1
+
+    GLuint vao_;
+    GLuint vertex_buffer_;
+    GLuint index_buffer_;
+    GLuint transform_buffer_;
+    GLuint modulation_buffer_;
+
+    // this frame's draw list and the scratch space to issue it
+    std::vector<Mesh*> queue_;
+    std::vector<GLfloat> transforms_;
+    std::vector<GLfloat> modulations_; // gain and mean/contrast vec4s
+    std::vector<GLuint> programs_;
+    std::vector<GLsizei> counts_;
+    std::vector<GLvoid*> offsets_;
+    std::vector<GLint> base_vertices_;
+
+    Renderer(const Renderer&);
+    Renderer& operator=(const Renderer&);
+};
+
+#endif
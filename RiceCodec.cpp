@@ -0,0 +1,169 @@
+#include "RiceCodec.h"
+
+/*********** bit packing, least significant bit first ***********/
+
+typedef struct BitWriter {
+    uint8_t* out;
+    size_t pos;
+    uint64_t acc;
+    int nbits;
+} BitWriter;
+
+static inline void putBits(BitWriter* w, uint32_t bits, int len) {
+    // len <= 32
+    w->acc |= (uint64_t)bits << w->nbits;
+    w->nbits += len;
+    while (w->nbits >= 8) {
+        w->out[w->pos++] = w->acc & 0xFF;
+        w->acc >>= 8;
+        w->nbits -= 8;
+    }
+}
+
+static inline void putUnary(BitWriter* w, uint32_t q) {
+    // q zeros followed by a one
+    while (q >= 32) {
+        putBits(w, 0, 32);
+        q -= 32;
+    }
+    putBits(w, 1u << q, q + 1);
+}
+
+typedef struct BitReader {
+    const uint8_t* in;
+    size_t bytes;
+    size_t pos;
+    uint64_t acc;
+    int nbits;
+} BitReader;
+
+static inline void refill(BitReader* r) {
+    while (r->nbits <= 56 && r->pos < r->bytes) {
+        r->acc |= (uint64_t)r->in[r->pos++] << r->nbits;
+        r->nbits += 8;
+    }
+}
+
+static inline bool getBits(BitReader* r, int len, uint32_t* bits) {
+    refill(r);
+    if (r->nbits < len) {
+        return false;
+    }
+    *bits = (uint32_t)(r->acc & ((1ull << len) - 1));
+    r->acc >>= len;
+    r->nbits -= len;
+    return true;
+}
+
+static inline bool getUnary(BitReader* r, uint32_t* q) {
+    *q = 0;
+    while (true) {
+        refill(r);
+        if (r->nbits == 0) {
+            return false;
+        }
+        if (r->acc == 0) {
+            // every buffered bit is a zero
+            *q += r->nbits;
+            r->nbits = 0;
+            continue;
+        }
+        int tz = __builtin_ctzll(r->acc);
+        *q += tz;
+        r->acc >>= tz + 1;
+        r->nbits -= tz + 1;
+        return true;
+    }
+}
+
+/*********** zigzag deltas ********************************/
+
+static inline uint8_t zigzag(uint8_t x, uint8_t prev) {
+    int8_t d = (int8_t)(uint8_t)(x - prev);
+    return (uint8_t)((d << 1) ^ (d >> 7));
+}
+
+static inline uint8_t unzigzag(uint8_t z, uint8_t prev) {
+    uint8_t d = (z >> 1) ^ (uint8_t)(-(z & 1));
+    return prev + d;
+}
+
+/*********** codec ********************************/
+
+size_t riceBound(size_t n) {
+    size_t segments = (n + kRiceSegment - 1) / kRiceSegment;
+    return (9 * n + 4 * segments + 7) / 8;
+}
+
+size_t riceEncode(const uint8_t* in, size_t n, uint8_t* out) {
+    BitWriter w = {out, 0, 0, 0};
+    uint8_t z[kRiceSegment];
+    uint8_t prev = 0;
+
+    for (size_t start = 0; start < n; start += kRiceSegment) {
+        size_t len = (n - start < (size_t)kRiceSegment) ? n - start : kRiceSegment;
+
+        for (size_t i = 0; i < len; ++i) {
+            z[i] = zigzag(in[start + i], prev);
+            prev = in[start + i];
+        }
+
+        // pick the k that makes this segment smallest; k = 8 is never
+        // worse than storing the samples with one extra bit each
+        uint32_t best_cost = ~0u;
+        int best_k = 8;
+        for (int k = 0; k <= 8; ++k) {
+            uint32_t cost = (k + 1) * len;
+            for (size_t i = 0; i < len; ++i) {
+                cost += z[i] >> k;
+            }
+            if (cost < best_cost) {
+                best_cost = cost;
+                best_k = k;
+            }
+        }
+
+        putBits(&w, best_k, 4);
+        uint32_t mask = (1u << best_k) - 1;
+        for (size_t i = 0; i < len; ++i) {
+            putUnary(&w, z[i] >> best_k);
+            if (best_k > 0) {
+                putBits(&w, z[i] & mask, best_k);
+            }
+        }
+    }
+
+    if (w.nbits > 0) {
+        out[w.pos++] = w.acc & 0xFF;
+    }
+    return w.pos;
+}
+
+size_t riceDecode(const uint8_t* in, size_t bytes, uint8_t* out, size_t n) {
+    BitReader r = {in, bytes, 0, 0, 0};
+    uint8_t prev = 0;
+
+    for (size_t start = 0; start < n; start += kRiceSegment) {
+        size_t len = (n - start < (size_t)kRiceSegment) ? n - start : kRiceSegment;
+
+        uint32_t k;
+        if (!getBits(&r, 4, &k) || k > 8) {
+            return 0;
+        }
+        for (size_t i = 0; i < len; ++i) {
+            uint32_t q, rem = 0;
+            if (!getUnary(&r, &q) || (k > 0 && !getBits(&r, k, &rem))) {
+                return 0;
+            }
+            uint32_t v = (q << k) | rem;
+            if (v > 255) {
+                return 0;
+            }
+            prev = unzigzag((uint8_t)v, prev);
+            out[start + i] = prev;
+        }
+    }
+
+    // bytes fetched into the accumulator but not used
+    return r.pos - r.nbits / 8;
+}
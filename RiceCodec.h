@@ -0,0 +1,33 @@
+#ifndef RICE_CODEC_H
+#define RICE_CODEC_H
+
+#include <stdint.h>
+#include <cstddef>
+
+/* Lossless codec for slowly varying 8-bit signals such as the raw
+ ventral-root samples.
+
+ Each sample is replaced by its difference from the previous one
+ (mod 256, zigzag mapped so small steps either way become small
+ numbers). The differences are Rice coded in segments of
+ kRiceSegment samples, each with its own parameter k picked to
+ minimise that segment's size, so quiet stretches and swim bouts
+ both code well. The worst case (k = 8) is 9 bits per sample.
+
+ Every call codes a self-contained block: the first difference is
+ taken from 0, so any chunk can be decoded on its own.
+ */
+
+static const int kRiceSegment = 256;
+
+// largest possible encoded size of n samples
+size_t riceBound(size_t n);
+
+// returns the number of bytes written to out, which must hold riceBound(n)
+size_t riceEncode(const uint8_t* in, size_t n, uint8_t* out);
+
+// decodes exactly n samples. returns the number of input bytes used,
+// or 0 if the input ran out first
+size_t riceDecode(const uint8_t* in, size_t bytes, uint8_t* out, size_t n);
+
+#endif
@@ -0,0 +1,118 @@
+#include "SerialReader.h"
+#include "Latency.h"
+#include <cstdio>
+
+SerialReader::SerialReader(serial::Serial* chan, uint8_t flag, size_t capacity)
+    : chan_(chan), decoder_(flag), ring_(capacity), stamps_(capacity + 1),
+      pushed_(0), popped_(0), last_arrival_(0),
+      running_(false), overruns_(0), stamp_overruns_(0) {
+}
+
+SerialReader::~SerialReader() {
+    stop();
+}
+
+void SerialReader::start() {
+    if (running_) {
+        return;
+    }
+    running_ = true;
+    thread_ = std::thread(&SerialReader::run, this);
+}
+
+void SerialReader::stop() {
+    running_ = false;
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+}
+
+bool SerialReader::pop(RootSample* sample) {
+    if (!ring_.pop(sample)) {
+        return false;
+    }
+    popped_++;
+    dropStamps();
+    return true;
+}
+
+void SerialReader::flush() {
+    // throw away everything that has arrived so far
+    RootSample s;
+    while (pop(&s)) {}
+    lastArrival();
+}
+
+unsigned long SerialReader::overruns() const {
+    return overruns_;
+}
+
+unsigned long SerialReader::stampOverruns() const {
+    return stamp_overruns_;
+}
+
+const FrameDecoder& SerialReader::decoder() const {
+    return decoder_;
+}
+
+void SerialReader::dropStamps() {
+    // drop stamps of blocks that have been used up. every block holds
+    // at least one sample, so the stamps left never outnumber the
+    // samples in the ring, plus the block being popped
+    BlockStamp stamp;
+    while (stamps_.front(&stamp) && stamp.end < popped_) {
+        stamps_.pop(&stamp);
+        last_arrival_ = stamp.arrival;
+    }
+}
+
+double SerialReader::lastArrival() {
+    // the first block left is the one holding the newest popped
+    // sample. if its stamp hasn't been pushed yet we keep the previous
+    // one, which errs on the side of reporting more latency
+    dropStamps();
+    BlockStamp stamp;
+    if (popped_ > 0 && stamps_.front(&stamp)) {
+        last_arrival_ = stamp.arrival;
+    }
+    return last_arrival_;
+}
+
+void SerialReader::run() {
+    while (running_) {
+        try {
+            // waitReadable() returns false when the port read timeout expires,
+            // which gives us a chance to notice stop() being called
+            if (!chan_->waitReadable()) {
+                continue;
+            }
+            size_t ba = chan_->available();
+            if (ba > kReadSize) {
+                ba = kReadSize;
+            }
+            if (ba == 0) {
+                continue;
+            }
+            ba = chan_->read(bytes_, ba);
+            double arrival = monotonicTime();
+
+            size_t n = decoder_.decode(bytes_, ba, samples_);
+            size_t pushed = ring_.push(samples_, n);
+            if (pushed < n) {
+                overruns_ += n - pushed;
+            }
+            if (pushed > 0) {
+                pushed_ += pushed;
+                BlockStamp stamp = {pushed_, arrival};
+                if (!stamps_.push(stamp)) {
+                    // can't happen with the ring sized to the samples,
+                    // but these samples would be stamped with a later block's time
+                    stamp_overruns_++;
+                }
+            }
+        } catch (std::exception& e) {
+            fprintf(stderr, "serial reader: %s\n", e.what());
+            running_ = false;
+        }
+    }
+}
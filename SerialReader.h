@@ -0,0 +1,70 @@
+#ifndef SERIAL_READER_H
+#define SERIAL_READER_H
+
+#include <serial/serial.h>
+#include <stdint.h>
+#include <atomic>
+#include <thread>
+#include "SpscRing.h"
+#include "FrameDecoder.h"
+
+// arrival time of the block of samples ending at sample number `end`
+typedef struct BlockStamp {
+    unsigned long long end;
+    double arrival;
+} BlockStamp;
+
+/* Drains a serial port on its own thread and pushes decoded samples
+ into a lock-free ring. The render loop pops whatever has arrived
+ since the last frame, so a slow frame never leaves samples sitting
+ in the OS buffer.
+
+ Every block read from the port is stamped with its monotonic
+ arrival time, so the consumer can tell how old its newest sample is.
+ */
+class SerialReader
+{
+public:
+    SerialReader(serial::Serial* chan, uint8_t flag, size_t capacity);
+    ~SerialReader();
+
+    void start();
+    void stop();
+
+    // consumer side, only call these from the render thread
+    bool pop(RootSample* sample);
+    void flush();
+
+    // arrival time of the newest sample popped so far, 0 if none
+    double lastArrival();
+
+    unsigned long overruns() const;
+    unsigned long stampOverruns() const; // blocks whose arrival time was lost
+
+    // decoder statistics, only meaningful once stop() has returned
+    const FrameDecoder& decoder() const;
+
+private:
+    void run();
+    void dropStamps();
+
+    serial::Serial* chan_;
+    FrameDecoder decoder_;
+    SpscRing<RootSample> ring_;
+    SpscRing<BlockStamp> stamps_;
+    unsigned long long pushed_; // samples pushed, reader thread only
+    unsigned long long popped_; // samples popped, render thread only
+    double last_arrival_;
+
+    std::thread thread_;
+    std::atomic<bool> running_;
+    std::atomic<unsigned long> overruns_; // samples dropped because the ring was full
+    std::atomic<unsigned long> stamp_overruns_;
+
+    // scratch space owned by the reader thread
+    static const size_t kReadSize = 4096;
+    uint8_t bytes_[kReadSize];
+    RootSample samples_[kReadSize / 3 + 1];
+};
+
+#endif
@@ -0,0 +1,117 @@
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+#include <atomic>
+#include <cstddef>
+
+/* Fixed-size single-producer/single-consumer ring buffer.
+ push() must only ever be called from one thread and pop() from
+ one other thread. Neither side locks or blocks: push() fails when
+ the ring is full and pop() fails when it is empty.
+ */
+template <typename T>
+class SpscRing
+{
+public:
+    explicit SpscRing(size_t capacity);
+    ~SpscRing();
+
+    bool push(const T& x);
+    size_t push(const T* x, size_t n);
+    bool pop(T* x);
+    bool front(T* x) const; // like pop() but leaves x in the ring
+
+    size_t size() const;
+    size_t capacity() const;
+
+private:
+    T* data_;
+    size_t mask_;
+
+    // head_ is only written by the producer and tail_ by the consumer.
+    // keep them on separate cache lines so the two threads don't fight.
+    alignas(64) std::atomic<size_t> head_;
+    alignas(64) std::atomic<size_t> tail_;
+
+    SpscRing(const SpscRing&);
+    SpscRing& operator=(const SpscRing&);
+};
+
+template <typename T>
+SpscRing<T>::SpscRing(size_t capacity)
+    : head_(0), tail_(0) {
+    // round capacity up to a power of two so indices wrap with a mask
+    size_t n = 1;
+    while (n < capacity) {
+        n <<= 1;
+    }
+    data_ = new T[n];
+    mask_ = n - 1;
+}
+
+template <typename T>
+SpscRing<T>::~SpscRing() {
+    delete[] data_;
+}
+
+template <typename T>
+bool SpscRing<T>::push(const T& x) {
+    size_t head = head_.load(std::memory_order_relaxed);
+    size_t tail = tail_.load(std::memory_order_acquire);
+    if (head - tail > mask_) {
+        return false; // full
+    }
+    data_[head & mask_] = x;
+    head_.store(head + 1, std::memory_order_release);
+    return true;
+}
+
+template <typename T>
+size_t SpscRing<T>::push(const T* x, size_t n) {
+    size_t head = head_.load(std::memory_order_relaxed);
+    size_t tail = tail_.load(std::memory_order_acquire);
+    size_t room = mask_ + 1 - (head - tail);
+    if (n > room) {
+        n = room;
+    }
+    for (size_t i = 0; i < n; ++i) {
+        data_[(head + i) & mask_] = x[i];
+    }
+    head_.store(head + n, std::memory_order_release);
+    return n;
+}
+
+template <typename T>
+bool SpscRing<T>::pop(T* x) {
+    size_t tail = tail_.load(std::memory_order_relaxed);
+    size_t head = head_.load(std::memory_order_acquire);
+    if (tail == head) {
+        return false; // empty
+    }
+    *x = data_[tail & mask_];
+    tail_.store(tail + 1, std::memory_order_release);
+    return true;
+}
+
+template <typename T>
+bool SpscRing<T>::front(T* x) const {
+    size_t tail = tail_.load(std::memory_order_relaxed);
+    size_t head = head_.load(std::memory_order_acquire);
+    if (tail == head) {
+        return false; // empty
+    }
+    *x = data_[tail & mask_];
+    return true;
+}
+
+template <typename T>
+size_t SpscRing<T>::size() const {
+    return head_.load(std::memory_order_acquire) - tail_.load(std::memory_order_acquire);
+}
+
+template <typename T>
+size_t SpscRing<T>::capacity() const {
+    return mask_ + 1;
+}
+
+#endif
@@ -0,0 +1,140 @@
+#include "SyncPulser.h"
+#include "Latency.h"
+#include "RecordFile.h"
+#include <cstdio>
+#include <ctime>
+
+SyncPulser::SyncPulser(serial::Serial* chan, uint8_t msg, size_t capacity)
+    : chan_(chan), msg_(msg), queue_(capacity), running_(false),
+      dropped_(0), failed_(0) {
+    sem_init(&pending_, 0, 0);
+    log_.reserve(1 << 16);
+}
+
+SyncPulser::~SyncPulser() {
+    stop();
+    sem_destroy(&pending_);
+}
+
+void SyncPulser::start() {
+    if (running_) {
+        return;
+    }
+    running_ = true;
+    thread_ = std::thread(&SyncPulser::run, this);
+}
+
+void SyncPulser::stop() {
+    running_ = false;
+    sem_post(&pending_);
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+}
+
+bool SyncPulser::submit(int level, int trial, double scheduled) {
+    SyncPulse pulse;
+    pulse.scheduled = scheduled;
+    pulse.submitted = monotonicTime();
+    pulse.written = 0;
+    pulse.level = level;
+    pulse.trial = trial;
+    pulse.bytes = 0;
+    if (!queue_.push(pulse)) {
+        dropped_++;
+        return false;
+    }
+    sem_post(&pending_);
+    return true;
+}
+
+void SyncPulser::write(SyncPulse* pulse) {
+    try {
+        pulse->bytes = chan_->write(&msg_, 1);
+    } catch (std::exception& e) {
+        fprintf(stderr, "sync pulser: %s\n", e.what());
+        pulse->bytes = 0;
+    }
+    pulse->written = monotonicTime();
+    if (pulse->bytes == 0) {
+        failed_++;
+    }
+}
+
+void SyncPulser::drain() {
+    SyncPulse pulse;
+    while (queue_.pop(&pulse)) {
+        write(&pulse);
+        log_.push_back(pulse);
+    }
+}
+
+void SyncPulser::run() {
+    while (true) {
+        drain();
+        if (!running_) {
+            // a pulse submitted just before stop() can land after the
+            // drain above; running_ is cleared after its push, so one
+            // more drain is sure to see it
+            drain();
+            break;
+        }
+
+        // the timeout only matters if a wake-up is missed
+        timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_nsec += 100000000;
+        if (deadline.tv_nsec >= 1000000000) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000;
+        }
+        sem_timedwait(&pending_, &deadline);
+    }
+}
+
+const std::vector<SyncPulse>& SyncPulser::pulses() const {
+    return log_;
+}
+
+unsigned long SyncPulser::dropped() const {
+    return dropped_;
+}
+
+unsigned long SyncPulser::failed() const {
+    return failed_;
+}
+
+double SyncPulser::worstWrite() const {
+    double worst = 0;
+    for (unsigned int i = 0; i < log_.size(); ++i) {
+        double t = log_[i].written - log_[i].submitted;
+        worst = (t > worst) ? t : worst;
+    }
+    return worst;
+}
+
+bool SyncPulser::save(const char* path) {
+    RecordFile file(1 << 16);
+    int scheduled_ch = file.addChannel("scheduled", RECORD_FLOAT64, 0);
+    int submitted_ch = file.addChannel("submitted", RECORD_FLOAT64, 0);
+    int written_ch = file.addChannel("written", RECORD_FLOAT64, 0);
+    int level_ch = file.addChannel("level", RECORD_INT32, 0);
+    int trial_ch = file.addChannel("trial", RECORD_INT32, 0);
+    int bytes_ch = file.addChannel("bytes", RECORD_INT32, 0);
+    file.addParam("clock", "CLOCK_MONOTONIC seconds");
+    file.addParam("dropped", (double)dropped_);
+
+    if (!file.open(path)) {
+        return false;
+    }
+    for (unsigned int i = 0; i < log_.size(); ++i) {
+        const SyncPulse& p = log_[i];
+        file.append(scheduled_ch, p.scheduled);
+        file.append(submitted_ch, p.submitted);
+        file.append(written_ch, p.written);
+        file.append(level_ch, &p.level, 1);
+        file.append(trial_ch, &p.trial, 1);
+        file.append(bytes_ch, &p.bytes, 1);
+    }
+    return file.close();
+}
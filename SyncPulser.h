@@ -0,0 +1,74 @@
+#ifndef SYNC_PULSER_H
+#define SYNC_PULSER_H
+
+#include <serial/serial.h>
+#include <semaphore.h>
+#include <stdint.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include "SpscRing.h"
+
+// one edge sent to the synchronization board, times on monotonicTime()
+typedef struct SyncPulse {
+    double scheduled; // present time of the frame the edge marks
+    double submitted; // when the render thread queued it
+    double written;   // when the write to the port returned
+    int32_t level;    // 1 rising, 0 falling
+    int32_t trial;    // -1 outside a trial
+    int32_t bytes;    // written to the port, 0 if the write timed out or failed
+} SyncPulse;
+
+/* Writes sync pulses to a serial port on its own thread. submit()
+ stamps a pulse and pushes it into a lock-free ring, then wakes the
+ writer with sem_post(), so the render thread never waits on the
+ port: a write stuck for the whole port timeout only delays the
+ pulses queued behind it, and once the ring is full further pulses
+ are dropped and counted.
+
+ The writer stamps each pulse again when its write returns and keeps
+ the log until stop(); save() writes it out so stimulus epochs can be
+ aligned with the electrophysiology recording.
+ */
+class SyncPulser
+{
+public:
+    SyncPulser(serial::Serial* chan, uint8_t msg, size_t capacity);
+    ~SyncPulser();
+
+    void start();
+    void stop(); // writes the pulses still queued first
+
+    // render thread only. false if the pulse was dropped
+    bool submit(int level, int trial, double scheduled);
+
+    // only meaningful once stop() has returned
+    const std::vector<SyncPulse>& pulses() const;
+    unsigned long dropped() const;
+    unsigned long failed() const;
+    double worstWrite() const; // longest submit to write return, seconds
+    bool save(const char* path);
+
+private:
+    void run();
+    void drain();
+    void write(SyncPulse* pulse);
+
+    serial::Serial* chan_;
+    uint8_t msg_;
+    SpscRing<SyncPulse> queue_;
+    sem_t pending_;
+
+    std::thread thread_;
+    std::atomic<bool> running_;
+    unsigned long dropped_; // render thread only
+
+    // writer thread only, until stop()
+    std::vector<SyncPulse> log_;
+    unsigned long failed_;
+
+    SyncPulser(const SyncPulser&);
+    SyncPulser& operator=(const SyncPulser&);
+};
+
+#endif
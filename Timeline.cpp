@@ -0,0 +1,109 @@
+#include "Timeline.h"
+#include <cstdio>
+#include <cstdlib>
+
+Timeline::Timeline()
+    : next_(0), t0_(0), trial_(-1), on_(false), trial_start_(0), done_(false) {
+}
+
+void Timeline::clear() {
+    events_.clear();
+    next_ = 0;
+    t0_ = 0;
+    trial_ = -1;
+    on_ = false;
+    trial_start_ = 0;
+    done_ = false;
+}
+
+void Timeline::add(double time, int type, int trial) {
+    if (!events_.empty() && time < events_.back().time) {
+        fprintf(stderr, "timeline event at %.3f s added after one at %.3f s\n",
+                time, events_.back().time);
+        exit(EXIT_FAILURE);
+    }
+    TimelineEvent e;
+    e.time = time;
+    e.type = type;
+    e.trial = trial;
+    events_.push_back(e);
+}
+
+void Timeline::build(const TrialTable& table, double lead_in) {
+    clear();
+    events_.reserve(5 * table.length + 1);
+
+    // summed in double from the table, so an hour of trials lands
+    // where the table says it should
+    double t = lead_in;
+    for (int k = 0; k < table.length; ++k) {
+        add(t, EVENT_PARAMETERS, k);
+        add(t, EVENT_STIMULUS_ON, k);
+        add(t, EVENT_SYNC_HIGH, k);
+        t += table.duration[k];
+        add(t, EVENT_STIMULUS_OFF, k);
+        add(t, EVENT_SYNC_LOW, k);
+        t += table.inter_trial[k];
+    }
+    add(t, EVENT_END, -1);
+}
+
+void Timeline::start(double t0) {
+    t0_ = t0;
+    next_ = 0;
+    trial_ = -1;
+    on_ = false;
+    trial_start_ = t0;
+    done_ = false;
+}
+
+bool Timeline::next(double now, TimelineEvent* event) {
+    if (next_ == events_.size() || t0_ + events_[next_].time > now) {
+        return false;
+    }
+    *event = events_[next_++];
+    switch (event->type) {
+        case EVENT_PARAMETERS:
+            trial_ = event->trial;
+            break;
+        case EVENT_STIMULUS_ON:
+            on_ = true;
+            trial_start_ = t0_ + event->time;
+            break;
+        case EVENT_STIMULUS_OFF:
+            on_ = false;
+            break;
+        case EVENT_END:
+            done_ = true;
+            break;
+    }
+    return true;
+}
+
+int Timeline::trial() const {
+    return trial_;
+}
+
+bool Timeline::stimulusOn() const {
+    return on_;
+}
+
+double Timeline::trialStart() const {
+    return trial_start_;
+}
+
+double Timeline::elapsed(double now) const {
+    return (trial_ >= 0) ? now - trial_start_ : 0;
+}
+
+bool Timeline::done() const {
+    return done_;
+}
+
+double Timeline::duration() const {
+    return events_.empty() ? 0 : events_.back().time;
+}
+
+int Timeline::events() const {
+    return events_.size();
+}
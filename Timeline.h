@@ -0,0 +1,73 @@
+#ifndef TIMELINE_H
+#define TIMELINE_H
+
+#include <vector>
+#include "Protocol.h"
+
+enum TIMELINE_EVENT {
+    EVENT_PARAMETERS,   // load the trial's row of the table
+    EVENT_STIMULUS_ON,
+    EVENT_STIMULUS_OFF,
+    EVENT_SYNC_HIGH,
+    EVENT_SYNC_LOW,
+    EVENT_END
+};
+
+typedef struct TimelineEvent {
+    double time; // seconds from the start of the timeline
+    int type;
+    int trial;   // row of the trial table, -1 for EVENT_END
+} TimelineEvent;
+
+/* A session laid out ahead of time as a list of events on one clock.
+
+ Every event's time is computed from the trial table before the
+ session starts, so trial k begins at the sum of the earlier trials'
+ durations and inter-trial periods, however the frames fall. Each
+ frame, next() pops the events that are due by the time that frame
+ will be shown; the cursor only moves forward, so a frame costs O(1)
+ however long the session is.
+
+ The timeline also tracks the phase its events imply: which trial's
+ parameters are loaded, whether the stimulus is on and when it came
+ on, so motion can be computed from the trial's exact start rather
+ than accumulated frame by frame.
+
+ build() lays out the usual trial / inter-trial session. Other
+ designs can add() their own events, in time order.
+ */
+class Timeline
+{
+public:
+    Timeline();
+
+    void clear();
+    void add(double time, int type, int trial);
+    // each trial's parameters, stimulus on and sync high at its start,
+    // stimulus off and sync low after its duration, then its
+    // inter-trial period. the first trial starts after lead_in seconds
+    void build(const TrialTable& table, double lead_in);
+
+    void start(double t0); // t0 is when timeline time 0 is shown
+    bool next(double now, TimelineEvent* event); // false once none are due
+
+    int trial() const;         // last trial whose parameters came due, -1 before
+    bool stimulusOn() const;
+    double trialStart() const; // when the stimulus came on, same clock as t0
+    double elapsed(double now) const; // since trialStart(), 0 before the first trial
+    bool done() const;         // EVENT_END has been popped
+    double duration() const;
+    int events() const;
+
+private:
+    std::vector<TimelineEvent> events_;
+    size_t next_;
+    double t0_;
+
+    int trial_;
+    bool on_;
+    double trial_start_;
+    bool done_;
+};
+
+#endif
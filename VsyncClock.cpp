@@ -0,0 +1,117 @@
+#include "VsyncClock.h"
+#include "Latency.h"
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+VsyncClock::VsyncClock()
+    : period_(1.0 / 60), last_vblank_(-1), display_(NULL), drawable_(0),
+      get_sync_values_(NULL) {
+}
+
+void VsyncClock::init(double refresh_rate) {
+    if (refresh_rate > 0) {
+        period_ = 1 / refresh_rate;
+    }
+}
+
+bool VsyncClock::initOML(Display* display, GLXDrawable drawable) {
+    if (!display || !drawable) {
+        return false;
+    }
+    const char* extensions = glXQueryExtensionsString(display, DefaultScreen(display));
+    if (!extensions || !strstr(extensions, "GLX_OML_sync_control")) {
+        return false;
+    }
+    GetSyncValuesProc get_sync_values = (GetSyncValuesProc)
+        glXGetProcAddressARB((const GLubyte*) "glXGetSyncValuesOML");
+    GetMscRateProc get_msc_rate = (GetMscRateProc)
+        glXGetProcAddressARB((const GLubyte*) "glXGetMscRateOML");
+    if (!get_sync_values || !get_msc_rate) {
+        return false;
+    }
+
+    display_ = display;
+    drawable_ = drawable;
+    get_sync_values_ = get_sync_values;
+
+    // UST is only specified to be monotonic; use it only if it is
+    // the same clock as ours, as it is on Linux
+    double t;
+    if (!lastVblankOML(&t) || fabs(t - monotonicTime()) > 1) {
+        get_sync_values_ = NULL;
+        return false;
+    }
+
+    int32_t numerator, denominator;
+    if (get_msc_rate(display, drawable, &numerator, &denominator) && numerator > 0) {
+        period_ = (double)denominator / numerator;
+    }
+    printf("vsync clock: GLX_OML_sync_control, %.3f Hz\n", 1 / period_);
+    return true;
+}
+
+bool VsyncClock::lastVblankOML(double* t) {
+    int64_t ust, msc, sbc;
+    if (!get_sync_values_(display_, drawable_, &ust, &msc, &sbc)) {
+        return false;
+    }
+    *t = 1e-6 * ust;
+    return true;
+}
+
+double VsyncClock::predict() {
+    double now = monotonicTime();
+    double vblank = last_vblank_;
+    if (get_sync_values_) {
+        lastVblankOML(&vblank);
+    }
+    if (vblank < 0) {
+        return now;
+    }
+
+    // the next vblank we can still make
+    double t = vblank + period_;
+    if (t < now) {
+        t += period_ * ceil((now - t) / period_);
+    }
+    return t;
+}
+
+void VsyncClock::swapped() {
+    if (get_sync_values_) {
+        return; // the driver knows
+    }
+
+    double now = monotonicTime();
+    if (last_vblank_ < 0) {
+        last_vblank_ = now;
+        return;
+    }
+
+    double interval = now - last_vblank_;
+    double periods = floor(interval / period_ + 0.5);
+    if (periods < 1) {
+        periods = 1;
+    }
+    double expected = last_vblank_ + periods * period_;
+    double error = now - expected;
+
+    if (fabs(error) > period_ / 2) {
+        // lost track, e.g. after a long stall
+        last_vblank_ = now;
+        return;
+    }
+    if (periods <= 4) {
+        period_ += 0.01 * error / periods;
+    }
+    last_vblank_ = expected + 0.1 * error;
+}
+
+double VsyncClock::period() const {
+    return period_;
+}
+
+bool VsyncClock::usingOML() const {
+    return get_sync_values_ != NULL;
+}
@@ -0,0 +1,47 @@
+#ifndef VSYNC_CLOCK_H
+#define VSYNC_CLOCK_H
+
+#include <X11/Xlib.h>
+#include <GL/glx.h>
+#include <stdint.h>
+
+/* Predicts when the frame being rendered will reach the screen, on
+ the monotonicTime() clock, so stimulus state can be computed for the
+ moment it is seen rather than integrated over the previous frame's
+ duration.
+
+ With GLX_OML_sync_control the driver reports the time of the last
+ vblank and the exact refresh rate. Otherwise both are estimated from
+ swap completion times: each interval is rounded to a whole number of
+ refresh periods, so dropped frames don't bias the period, and the
+ vblank phase is tracked with a slow filter that absorbs swap jitter.
+ */
+class VsyncClock
+{
+public:
+    VsyncClock();
+
+    void init(double refresh_rate); // nominal rate, for the estimate
+    bool initOML(Display* display, GLXDrawable drawable);
+
+    double predict(); // present time of the next frame, seconds
+    void swapped();   // call right after the buffer swap
+
+    double period() const;
+    bool usingOML() const;
+
+private:
+    typedef Bool (*GetSyncValuesProc)(Display*, GLXDrawable, int64_t*, int64_t*, int64_t*);
+    typedef Bool (*GetMscRateProc)(Display*, GLXDrawable, int32_t*, int32_t*);
+
+    bool lastVblankOML(double* t);
+
+    double period_;
+    double last_vblank_; // estimated, -1 before the first swap
+
+    Display* display_;
+    GLXDrawable drawable_;
+    GetSyncValuesProc get_sync_values_;
+};
+
+#endif
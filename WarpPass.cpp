@@ -0,0 +1,124 @@
+#include "WarpPass.h"
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+WarpPass::WarpPass()
+    : enabled_(false), width_(0), height_(0), fbo_(0), output_fbo_(0), color_texture_(0),
+      depth_buffer_(0), lut_texture_(0), program_(0), vao_(0) {
+}
+
+WarpPass::~WarpPass() {
+}
+
+void WarpPass::init(GLuint program, int width, int height, float half_width) {
+    width_ = width;
+    height_ = height;
+
+    // offscreen target the stimulus is drawn into
+    glGenTextures(1, &color_texture_);
+    glBindTexture(GL_TEXTURE_2D, color_texture_);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0,
+                 GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    glGenRenderbuffers(1, &depth_buffer_);
+    glBindRenderbuffer(GL_RENDERBUFFER, depth_buffer_);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    glGenFramebuffers(1, &fbo_);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo_);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                           GL_TEXTURE_2D, color_texture_, 0);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
+                              GL_RENDERBUFFER, depth_buffer_);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        fprintf(stderr, "warp framebuffer is incomplete\n");
+        exit(EXIT_FAILURE);
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    // lookup texture, read with texelFetch so it is never filtered
+    glGenTextures(1, &lut_texture_);
+    glBindTexture(GL_TEXTURE_2D, lut_texture_);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    std::vector<float> uv;
+    buildCylinderLut(half_width, uv);
+    setLut(uv);
+
+    program_ = program;
+    glProgramUniform1i(program_, glGetUniformLocation(program_, "scene"), 0);
+    glProgramUniform1i(program_, glGetUniformLocation(program_, "lut"), 1);
+
+    glGenVertexArrays(1, &vao_);
+    enabled_ = true;
+}
+
+void WarpPass::setLut(const std::vector<float>& uv) {
+    glBindTexture(GL_TEXTURE_2D, lut_texture_);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RG32F, width_, height_, 0,
+                 GL_RG, GL_FLOAT, uv.data());
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void WarpPass::buildCylinderLut(float half_width, std::vector<float>& uv) {
+    uv.resize(2 * width_ * height_);
+    for (int j = 0; j < height_; ++j) {
+        float y = 2 * (j + 0.5f) / height_ - 1;
+        for (int i = 0; i < width_; ++i) {
+            float x_s = 2 * (i + 0.5f) / width_ - 1;
+            float* p = &uv[2 * (j * width_ + i)];
+            if (fabs(x_s) > half_width) {
+                p[0] = -1;
+                p[1] = -1;
+                continue;
+            }
+            // inverse of the cylinder projection
+            float x = half_width * (2 * acos(-x_s / half_width) / M_PI - 1);
+            p[0] = (x + 1) / 2;
+            p[1] = (y + 1) / 2;
+        }
+    }
+}
+
+void WarpPass::setOutput(GLuint framebuffer) {
+    output_fbo_ = framebuffer;
+}
+
+bool WarpPass::enabled() const {
+    return enabled_;
+}
+
+void WarpPass::begin() {
+    if (enabled_) {
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo_);
+    }
+}
+
+void WarpPass::end() {
+    if (!enabled_) {
+        return;
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, output_fbo_);
+    glDisable(GL_DEPTH_TEST);
+
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, color_texture_);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, lut_texture_);
+    glActiveTexture(GL_TEXTURE0);
+
+    glUseProgram(program_);
+    glBindVertexArray(vao_);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    glBindVertexArray(0);
+
+    glEnable(GL_DEPTH_TEST);
+}
@@ -0,0 +1,58 @@
+#ifndef WARP_PASS_H
+#define WARP_PASS_H
+
+#include <GL/glew.h>
+#include <vector>
+
+/* Projection warp for the curved screen. With the warp on, stimuli
+ are drawn by "flat" shaders into an offscreen target whose x axis is
+ linear in degrees of visual angle. A fullscreen pass then looks up,
+ for every screen pixel, where to sample that target in a lookup
+ texture (RG32F, -1 where no stimulus belongs) built once at start-up
+ from the screen geometry.
+
+ The default map is the cylinder model used by rotating_grating.vert:
+ a point at flat x in [-r, r] lands on the screen at
+
+   x_s = -r cos(pi (x + r) / 2r)
+
+ so the map is exact per pixel rather than per vertex. A measured
+ calibration can replace it through setLut().
+ */
+class WarpPass
+{
+public:
+    WarpPass();
+    ~WarpPass();
+
+    // needs a current GL context. program is built from warp.vert and
+    // warp.frag; half_width is the screen's half width in GL units
+    // (SCREEN_WIDTH_GL / 2)
+    void init(GLuint program, int width, int height, float half_width);
+    void setLut(const std::vector<float>& uv); // width * height (u, v) pairs
+    void setOutput(GLuint framebuffer); // default framebuffer unless set
+
+    bool enabled() const;
+
+    void begin(); // draw the stimulus after this
+    void end();   // warps it onto the default framebuffer
+
+private:
+    void buildCylinderLut(float half_width, std::vector<float>& uv);
+
+    bool enabled_;
+    int width_;
+    int height_;
+    GLuint fbo_;
+    GLuint output_fbo_;
+    GLuint color_texture_;
+    GLuint depth_buffer_;
+    GLuint lut_texture_;
+    GLuint program_;
+    GLuint vao_;
+
+    WarpPass(const WarpPass&);
+    WarpPass& operator=(const WarpPass&);
+};
+
+#endif
@@ -0,0 +1,55 @@
+#include "WindowStats.h"
+
+WindowStats::WindowStats(int capacity)
+    : capacity_(capacity) {
+    data_ = new uint8_t[capacity_];
+    clear();
+}
+
+WindowStats::~WindowStats() {
+    delete[] data_;
+}
+
+void WindowStats::push_back(uint8_t x) {
+    if (size_ == capacity_) {
+        // window is full, the oldest sample falls out
+        int64_t old = data_[head_];
+        sum_ -= old;
+        sum_sq_ -= old * old;
+    } else {
+        size_++;
+    }
+    data_[head_] = x;
+    sum_ += x;
+    sum_sq_ += (int64_t)x * x;
+    head_ = (head_ + 1 == capacity_) ? 0 : head_ + 1;
+}
+
+void WindowStats::clear() {
+    size_ = 0;
+    head_ = 0;
+    sum_ = 0;
+    sum_sq_ = 0;
+}
+
+int WindowStats::size() const {
+    return size_;
+}
+
+int WindowStats::capacity() const {
+    return capacity_;
+}
+
+float WindowStats::mean() const {
+    return (size_ > 0) ? (double)sum_ / size_ : 0;
+}
+
+float WindowStats::stdDev() const {
+    if (size_ < 2) {
+        return 0;
+    }
+    // n * sum(x^2) - sum(x)^2 is exact in integers
+    int64_t n = size_;
+    int64_t num = n * sum_sq_ - sum_ * sum_;
+    return sqrt((double)num / (double)(n * (n - 1)));
+}
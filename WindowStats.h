@@ -0,0 +1,41 @@
+#ifndef WINDOW_STATS_H
+#define WINDOW_STATS_H
+
+#include <stdint.h>
+#include <cmath>
+
+/* Mean and standard deviation over the last N samples of an 8-bit
+ stream. Running sums are updated on every push_back(), so both
+ statistics cost the same no matter how long the window is. Sums are
+ kept as exact integers, so there is no floating point drift however
+ many samples go through.
+ */
+class WindowStats
+{
+public:
+    WindowStats(int capacity);
+    ~WindowStats();
+
+    void push_back(uint8_t x);
+    void clear();
+
+    int size() const;
+    int capacity() const;
+
+    float mean() const;
+    float stdDev() const; // sample std. dev. (n - 1), 0 with fewer than 2 samples
+
+private:
+    uint8_t* data_;
+    int capacity_;
+    int size_;
+    int head_; // slot the next sample goes into
+
+    int64_t sum_;
+    int64_t sum_sq_;
+
+    WindowStats(const WindowStats&);
+    WindowStats& operator=(const WindowStats&);
+};
+
+#endif
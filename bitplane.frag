@@ -0,0 +1,18 @@
+#version 410
+
+uniform sampler2D subframe; // one subframe of the stimulus
+uniform int bit_planes;     // 1: one bit per subframe, 0: eight
+uniform float weight;       // 2^bit / 255 when bit_planes is set
+
+out vec4 fcolor;
+
+void main()
+{
+    // the projector shows each plane in one color, so only the
+    // stimulus's intensity matters
+    vec3 c = texelFetch(subframe, ivec2(gl_FragCoord.xy), 0).rgb;
+    float v = max(c.r, max(c.g, c.b));
+    if (bit_planes != 0)
+        v = step(0.5, v) * weight;
+    fcolor = vec4(v, v, v, 1);
+}
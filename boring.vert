@@ -2,13 +2,14 @@
 
 layout (location = 0) in vec2 vPosition;
 layout (location = 1) in vec4 vColor;
+layout (location = 2) in uint vObject;
 
-uniform mat4 transform_matrix;
-
+// transforms[] and modulate() come from modulation.glsl
 flat out vec4 color;
 
 void main()
 {
+    mat4 transform_matrix = transforms[vObject];
     gl_Position = transform_matrix * vec4(vPosition, 0, 1);
-    color = vColor / 255;
+    color = modulate(vColor / 255, vObject);
 }
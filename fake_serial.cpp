@@ -0,0 +1,307 @@
+/* Stand-in for the ventral-root arduino and the synchronization board.
+
+ Creates two pseudo-terminals and symlinks them to paths the stimulus
+ program can open in place of /dev/ttyACM1 and /dev/ttyACM0:
+
+   $ ./fake_serial -l /tmp/ttyACM1 -s /tmp/ttyACM0 &
+   $ ./game -c /tmp/ttyACM1 -s /tmp/ttyACM0 2 fish01
+
+ The data port streams [0xFF, data0, data1] frames exactly like
+ ventralRootCodeV2_8bit does, paced to the byte rate of the serial
+ line. Frames come either from a raw capture of the real port
+ (e.g. `cat /dev/ttyACM1 > capture.bin`) replayed in a loop, or from a
+ synthetic signal with alternating left/right swim bouts. Bytes
+ written to the sync port are logged with their arrival time.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <cerrno>
+#include <ctime>
+#include <vector>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdint.h>
+#include <termios.h>
+#include <unistd.h>
+
+static volatile sig_atomic_t g_running = 1;
+
+static void stop_handler(int sig) {
+    g_running = 0;
+}
+
+static double now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + 1e-9 * ts.tv_nsec;
+}
+
+static double uniform() {
+    return rand() / (RAND_MAX + 1.0);
+}
+
+static double gaussian() {
+    // Box-Muller
+    double u = uniform() + 1e-12;
+    double v = uniform();
+    return sqrt(-2 * log(u)) * cos(2 * M_PI * v);
+}
+
+/*********** pseudo-terminals ********************************/
+
+struct Pty {
+    int master;
+    int slave; // kept open so the master never sees a hang-up
+};
+
+static bool openPty(const char* link, Pty* pty) {
+    pty->master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (pty->master < 0 || grantpt(pty->master) < 0 || unlockpt(pty->master) < 0) {
+        perror("posix_openpt");
+        return false;
+    }
+    const char* name = ptsname(pty->master);
+    pty->slave = open(name, O_RDWR | O_NOCTTY);
+    if (pty->slave < 0) {
+        perror(name);
+        return false;
+    }
+
+    // raw mode: no echo, no line discipline, no byte translation
+    struct termios tio;
+    tcgetattr(pty->slave, &tio);
+    cfmakeraw(&tio);
+    tcsetattr(pty->slave, TCSANOW, &tio);
+
+    fcntl(pty->master, F_SETFL, fcntl(pty->master, F_GETFL) | O_NONBLOCK);
+
+    unlink(link);
+    if (symlink(name, link) < 0) {
+        perror(link);
+        return false;
+    }
+    printf("%s -> %s\n", link, name);
+    return true;
+}
+
+/*********** frame sources ********************************/
+
+struct Source {
+    std::vector<uint8_t> capture; // raw bytes of a recorded stream, if any
+    size_t pos;
+
+    // synthetic signal state
+    double t;
+    double bout_start;
+    double bout_end;
+    int bout_side;
+};
+
+static uint8_t clamp8(double x) {
+    if (x < 0) {
+        return 0;
+    }
+    if (x > 255) {
+        return 255;
+    }
+    return (uint8_t)(x + 0.5);
+}
+
+static void nextFrame(Source* src, double frame_period, uint8_t frame[3]) {
+    frame[0] = 0xFF;
+
+    if (!src->capture.empty()) {
+        // replay the recording frame by frame, starting at a flag
+        if (src->pos + 3 > src->capture.size()) {
+            src->pos = 0;
+        }
+        while (src->pos + 3 <= src->capture.size() && src->capture[src->pos] != 0xFF) {
+            src->pos++;
+        }
+        if (src->pos + 3 > src->capture.size()) {
+            src->pos = 0;
+            frame[1] = frame[2] = 128;
+            return;
+        }
+        frame[1] = src->capture[src->pos + 1];
+        frame[2] = src->capture[src->pos + 2];
+        src->pos += 3;
+        return;
+    }
+
+    // synthetic: quiet baseline around mid-scale, with a 200 ms swim
+    // bout every 1-3 s that drives one side harder than the other
+    src->t += frame_period;
+    if (src->t > src->bout_end + 1 + 2 * uniform()) {
+        src->bout_start = src->t;
+        src->bout_end = src->t + 0.2;
+        src->bout_side = !src->bout_side;
+    }
+
+    double sd0 = 3, sd1 = 3;
+    if (src->t >= src->bout_start && src->t < src->bout_end) {
+        double burst = (fmod(src->t - src->bout_start, 0.04) < 0.02) ? 1 : 0.3;
+        sd0 += burst * (src->bout_side ? 40 : 20);
+        sd1 += burst * (src->bout_side ? 20 : 40);
+    }
+    frame[1] = clamp8(128 + sd0 * gaussian());
+    frame[2] = clamp8(128 + sd1 * gaussian());
+}
+
+static bool loadCapture(const char* path, Source* src) {
+    FILE* file = fopen(path, "rb");
+    if (!file) {
+        perror(path);
+        return false;
+    }
+    uint8_t buf[4096];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), file)) > 0) {
+        src->capture.insert(src->capture.end(), buf, buf + n);
+    }
+    fclose(file);
+    printf("replaying %zu bytes from %s\n", src->capture.size(), path);
+    return !src->capture.empty();
+}
+
+/************ main ************************/
+
+static void usage(const char* prog) {
+    fprintf(stderr,
+            "usage: %s [options]\n"
+            "  -l path   data port link (default /tmp/ttyACM1)\n"
+            "  -s path   sync port link (default /tmp/ttyACM0)\n"
+            "  -f file   replay a raw capture instead of synthetic data\n"
+            "  -b baud   line rate, 10 bits per byte (default 921600)\n"
+            "  -B n      frames per burst (default 21, one 64-byte USB packet)\n"
+            "  -d p      probability of dropping a whole frame\n"
+            "  -x p      probability of dropping one byte of a frame\n"
+            "  -j us     max random delay added to each burst\n"
+            "  -t sec    stop after this many seconds (default: run until killed)\n",
+            prog);
+    exit(EXIT_FAILURE);
+}
+
+int main(int argc, char** argv) {
+    const char* data_link = "/tmp/ttyACM1";
+    const char* sync_link = "/tmp/ttyACM0";
+    const char* capture_path = NULL;
+    double baud = 8 * 115200;
+    int burst = 21;
+    double p_drop = 0;
+    double p_corrupt = 0;
+    double jitter = 0;
+    double duration = 0;
+
+    int c;
+    while ((c = getopt(argc, argv, "l:s:f:b:B:d:x:j:t:h")) != -1) {
+        switch (c) {
+            case 'l': data_link = optarg; break;
+            case 's': sync_link = optarg; break;
+            case 'f': capture_path = optarg; break;
+            case 'b': baud = atof(optarg); break;
+            case 'B': burst = atoi(optarg); break;
+            case 'd': p_drop = atof(optarg); break;
+            case 'x': p_corrupt = atof(optarg); break;
+            case 'j': jitter = 1e-6 * atof(optarg); break;
+            case 't': duration = atof(optarg); break;
+            default: usage(argv[0]);
+        }
+    }
+    if (baud <= 0 || burst < 1) {
+        usage(argv[0]);
+    }
+
+    Source src;
+    src.pos = 0;
+    src.t = 0;
+    src.bout_start = src.bout_end = 0;
+    src.bout_side = 0;
+    if (capture_path && !loadCapture(capture_path, &src)) {
+        exit(EXIT_FAILURE);
+    }
+
+    Pty data, sync;
+    if (!openPty(data_link, &data) || !openPty(sync_link, &sync)) {
+        exit(EXIT_FAILURE);
+    }
+
+    signal(SIGINT, stop_handler);
+    signal(SIGTERM, stop_handler);
+    srand(time(NULL));
+
+    // 3 bytes per frame, 10 bits per byte on the wire
+    const double frame_period = 30.0 / baud;
+    printf("streaming %.0f frames/s in bursts of %d\n", 1 / frame_period, burst);
+
+    std::vector<uint8_t> out(3 * burst);
+    unsigned long frames = 0, dropped = 0, corrupted = 0, overflowed = 0, pulses = 0;
+    double t0 = now();
+    double due = t0;
+
+    while (g_running && (duration <= 0 || due - t0 < duration)) {
+
+        // wait for the next burst, logging sync pulses in the meantime
+        double wait = due + jitter * uniform() - now();
+        if (wait > 0) {
+            struct timespec ts;
+            ts.tv_sec = (time_t)wait;
+            ts.tv_nsec = (long)((wait - ts.tv_sec) * 1e9);
+            struct pollfd pfd = {sync.master, POLLIN, 0};
+            if (ppoll(&pfd, 1, &ts, NULL) > 0) {
+                uint8_t b[64];
+                ssize_t n = read(sync.master, b, sizeof(b));
+                for (ssize_t i = 0; i < n; ++i) {
+                    printf("sync %lu at %.6f s\n", ++pulses, now() - t0);
+                }
+                continue;
+            }
+        }
+
+        // build the burst
+        size_t len = 0;
+        for (int i = 0; i < burst; ++i) {
+            uint8_t frame[3];
+            nextFrame(&src, frame_period, frame);
+            frames++;
+            if (uniform() < p_drop) {
+                dropped++;
+                continue;
+            }
+            int skip = -1;
+            if (uniform() < p_corrupt) {
+                skip = rand() % 3;
+                corrupted++;
+            }
+            for (int j = 0; j < 3; ++j) {
+                if (j != skip) {
+                    out[len++] = frame[j];
+                }
+            }
+        }
+
+        // the real device doesn't wait for the host, so neither do we
+        ssize_t n = write(data.master, out.data(), len);
+        if (n < (ssize_t)len) {
+            overflowed += len - (n > 0 ? n : 0);
+        }
+
+        // schedule on an absolute clock so jitter doesn't accumulate
+        due += burst * frame_period;
+    }
+
+    printf("%lu frames, %lu dropped, %lu corrupted, %lu bytes lost to a full buffer, %lu sync pulses\n",
+           frames, dropped, corrupted, overflowed, pulses);
+
+    unlink(data_link);
+    unlink(sync_link);
+    close(data.master);
+    close(data.slave);
+    close(sync.master);
+    close(sync.slave);
+    return 0;
+}
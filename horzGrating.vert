@@ -3,16 +3,17 @@
 
 layout(location = 0) in vec2 vPosition;
 layout(location = 1) in vec4 vColor;
+layout(location = 2) in uint vObject;
 
-uniform mat4 transform_matrix;
-
+// transforms[] and modulate() come from modulation.glsl
 flat out vec4 color;
 
 void main() {
+    mat4 transform_matrix = transforms[vObject];
     vec2 w = vPosition;
     w.y -= 1;
     gl_Position = transform_matrix * vec4(w, 0, 1);
     
-    color = vColor / 255;
+    color = modulate(vColor / 255, vObject);
 }
 
@@ -0,0 +1,22 @@
+#version 410
+
+layout (location = 0) in vec2 vPosition;
+
+// per instance, see InstancedDots.h
+layout (location = 3) in vec2 iPosition;
+layout (location = 4) in vec2 iVelocity;
+layout (location = 5) in float iSize;
+layout (location = 6) in vec4 iColor;
+
+uniform float time_offset; // seconds since the instances were uploaded
+uniform float wrap_width;  // dots leaving one edge enter at the other
+
+flat out vec4 color;
+
+void main()
+{
+    vec2 center = iPosition + iVelocity * time_offset;
+    center.x = mod(center.x + wrap_width / 2, wrap_width) - wrap_width / 2;
+    gl_Position = vec4(center + iSize * vPosition, 0, 1);
+    color = iColor / 255;
+}
@@ -3,13 +3,14 @@
 
 layout(location = 0) in vec2 vPosition;
 layout(location = 1) in vec4 vColor;
+layout(location = 2) in uint vObject;
 
-uniform mat4 transform_matrix;
-
+// transforms[] and modulate() come from modulation.glsl
 flat out vec4 color;
 
 void main()
 {
+    mat4 transform_matrix = transforms[vObject];
     int sign = 1;
     vec2 w = vPosition;
     if (abs(w.y) > 1)
@@ -28,5 +29,5 @@ void main()
         p.x = sign * r;
     
     gl_Position = p;
-    color = vColor / 255;
+    color = modulate(vColor / 255, vObject);
 }
@@ -0,0 +1,36 @@
+#version 410
+#define PI 3.14159265359
+
+layout(location = 0) in vec2 vPosition;
+layout(location = 1) in vec4 vColor;
+layout(location = 2) in uint vObject;
+
+// transforms[] and modulate() come from modulation.glsl
+flat out vec4 color;
+
+void main()
+{
+    mat4 transform_matrix = transforms[vObject];
+    int sign = 1;
+    vec2 w = vPosition;
+    if (abs(w.y) > 1)
+        w.y /= 2;
+    else
+        sign *= -1;
+    
+    vec4 p = transform_matrix * vec4(w, 0, 1);
+    
+    float r = transform_matrix[0][0];    
+    if (p.x > 0 && p.x < r)
+        p.x = sign * sqrt(r * r - p.x * p.x);
+    else if (p.x >= r)
+        p.x = 0;
+    else
+        p.x = sign * r;
+    
+    // undo the cylinder projection, the warp pass puts it back per pixel
+    p.x = r * (2 * acos(clamp(-p.x / r, -1.0, 1.0)) / PI - 1);
+    
+    gl_Position = p;
+    color = modulate(vColor / 255, vObject);
+}
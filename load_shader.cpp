@@ -12,6 +12,7 @@ using namespace std;
 
 // This is a basic program to initiate a shader
 // The textFileRead function reads in a filename into a string
+// shaderSource reads a shader and adds the shared declarations
 // programerrors and shadererrors output compilation errors
 // initshaders initiates a vertex or fragment shader
 // initprogram initiates a program with vertex and fragment shaders
@@ -35,6 +36,28 @@ string textFileRead(const char* filename) {
 	}
 }
 
+string shaderSource(GLenum type, const char* filename) {
+	// vertex shaders get modulation.glsl, from the same directory,
+	// inserted after their #version line. #line keeps the compiler's
+	// line numbers pointing into the right file
+	string source = textFileRead(filename);
+	if (type != GL_VERTEX_SHADER) {
+		return source;
+	}
+	string dir = filename;
+	size_t slash = dir.rfind('/');
+	dir = (slash == string::npos) ? "" : dir.substr(0, slash + 1);
+	string include = textFileRead((dir + "modulation.glsl").c_str());
+	
+	size_t eol = source.find('\n');
+	if (eol == string::npos || source.compare(0, 8, "#version") != 0) {
+		cerr << filename << " must start with a #version line\n";
+		throw 2;
+	}
+	return source.substr(0, eol + 1) + "#line 1 1\n" + include +
+	       "#line 2 0\n" + source.substr(eol + 1);
+}
+
 void programerrors(const GLint program) {
 	GLint length;
 	GLchar* log;
@@ -61,7 +84,7 @@ GLuint initshaders(GLenum type, const char *filename)
     
 	GLuint shader = glCreateShader(type);
 	GLint compiled;
-	string str = textFileRead (filename);
+	string str = shaderSource(type, filename);
 	GLchar* cstr = new GLchar[str.size()+1];
 	const GLchar* cstr2 = cstr; // Weirdness to get a const char
 	strcpy(cstr, str.c_str());
@@ -5,6 +5,7 @@
 #include "Mesh.h"
 
 std::string textFileRead(const char* filename);
+std::string shaderSource(GLenum type, const char* filename);
 void programerrors(const GLint program);
 void shadererrors(const GLint shader);
 GLuint initshaders(GLenum type, const char* filename);
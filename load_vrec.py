@@ -0,0 +1,79 @@
+"""Load a .vrec recording written by RecordFile into NumPy arrays.
+
+    >>> rec = load_vrec("fish01_closed_loop.vrec")
+    >>> rec["channels"]["fish_vel"]      # numpy array
+    >>> rec["params"]["bias"]            # string
+
+Chunks are read straight out of a memory map. A channel written in a
+single chunk comes back as a zero-copy view of the file. Compressed
+("rice") channels have to be expanded first with `vrec_decode`.
+"""
+
+import mmap
+import struct
+import sys
+
+import numpy as np
+
+
+def load_vrec(path):
+    with open(path, "rb") as f:
+        mm = mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ)
+
+    magic, version, header_bytes = struct.unpack_from("<4sII", mm, 0)
+    if magic != b"VREC":
+        raise ValueError("%s is not a .vrec file" % path)
+
+    names, dtypes, rates, params = {}, {}, {}, {}
+    header = bytes(mm[12:12 + header_bytes]).decode("ascii")
+    for line in header.splitlines():
+        fields = line.split(None, 2)
+        if not fields:
+            continue
+        if fields[0] == "channel":
+            words = line.split()
+            cid, name, dtype, rate = words[1:5]
+            codec = words[5] if len(words) > 5 else "raw"
+            if codec != "raw":
+                raise ValueError("channel %s of %s is %s coded, run vrec_decode first"
+                                 % (name, path, codec))
+            names[int(cid)] = name
+            dtypes[int(cid)] = np.dtype(dtype)
+            rates[name] = float(rate)
+        elif fields[0] == "param":
+            params[fields[1]] = fields[2].strip() if len(fields) > 2 else ""
+
+    pieces = dict((cid, []) for cid in names)
+    pos = 12 + header_bytes
+    while pos + 16 <= len(mm):
+        tag, cid, count, nbytes = struct.unpack_from("<4sIII", mm, pos)
+        if tag != b"CHNK":
+            raise ValueError("bad chunk at offset %d" % pos)
+        pos += 16
+        if pos + nbytes > len(mm):
+            break  # truncated final chunk, e.g. after a crash
+        pieces[cid].append(np.frombuffer(mm, dtypes[cid], count, pos))
+        pos += (nbytes + 7) & ~7
+
+    channels = {}
+    for cid, name in names.items():
+        p = pieces[cid]
+        if len(p) == 1:
+            channels[name] = p[0]
+        elif p:
+            channels[name] = np.concatenate(p)
+        else:
+            channels[name] = np.zeros(0, dtypes[cid])
+
+    return {"version": version, "params": params,
+            "sample_rates": rates, "channels": channels}
+
+
+if __name__ == "__main__":
+    for path in sys.argv[1:]:
+        rec = load_vrec(path)
+        print(path)
+        for key, value in sorted(rec["params"].items()):
+            print("  %s = %s" % (key, value))
+        for name, data in sorted(rec["channels"].items()):
+            print("  %-20s %-6s %d samples" % (name, data.dtype.str, len(data)))
@@ -1,17 +1,39 @@
 
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
+#define GLFW_EXPOSE_NATIVE_X11
+#define GLFW_EXPOSE_NATIVE_GLX
+#include <GLFW/glfw3native.h>
 #include <serial/serial.h>
 #include <numeric>
-#include <boost/circular_buffer.hpp>
+#include <algorithm>
 #include <cstdio>
 #include <cmath>
 #include <cstring>
+#include <thread>
+#include <unistd.h>
 
 #include "Vertex2D.h"
 #include "load_shader.h"
 #include "Mesh.h"
 #include "Protocol.h"
+#include "SerialReader.h"
+#include "WindowStats.h"
+#include "RecordFile.h"
+#include "Latency.h"
+#include "FrameTimer.h"
+#include "Renderer.h"
+#include "ProceduralGrating.h"
+#include "WarpPass.h"
+#include "Headless.h"
+#include "VsyncClock.h"
+#include "InstancedDots.h"
+#include "ProgramCache.h"
+#include "BitPlanePacker.h"
+#include "DisplayOutputs.h"
+#include "Random.h"
+#include "Timeline.h"
+#include "SyncPulser.h"
 
 #define PI 3.14159265359
 #define SCREEN_WIDTH_GL 0.7
@@ -22,15 +44,32 @@
 #define OPEN_LOOP_PREY 1
 #define CLOSED_LOOP_OMR 2
 #define CLOSED_LOOP_PREY 3
+#define OPEN_LOOP_GRATING_SWEEP 4
+#define OPEN_LOOP_PREY_SWARM 5
 
 /************* globals ***********************/
 
 void (*g_drawFunc)(); // points to the appropriate draw function
-void (*g_updateFunc)(); // points to the appropriate update function
 
-// sequences of speeds, sizes and directions for prey and omr experiments
+// what an experiment does at the points of its timeline, NULL for nothing
+typedef struct TrialHandlers {
+    void (*start)();   // the stimulus comes on, the trial's parameters are loaded
+    void (*update)();  // every frame the stimulus is on
+    void (*stop)();    // the stimulus goes off
+    void (*between)(); // every frame between trials, the reader is flushed if NULL
+} TrialHandlers;
+TrialHandlers g_handlers;
+
+// sequences of speeds, sizes and directions for prey and omr experiments,
+// from a protocol file (-p) or the built-in design for the experiment
 Protocol g_protocol;
 Protocol g_calibration_protocol; // open-loop calibration for closed loop
+const TrialTable* g_table = NULL; // of the protocol being run
+int g_row = -1; // its current trial
+Timeline g_timeline; // of the protocol being run
+const double g_lead_in = 10; // seconds before the first open-loop trial
+int g_stimulus_frames = 0; // updates of the current trial with the stimulus on
+int g_lost_trials = 0; // trials a late frame skipped entirely
 
 // meshes for experiments (sets of vertices, colors and data for drawing shapes.
 // constructor arguments indicate which shaders to use with a mesh
@@ -38,18 +77,56 @@ Mesh g_background("./rotating_grating.vert", "./boring.frag");
 Mesh g_prey("./boring.vert", "./boring.frag");
 Mesh g_rotating("./rotating_grating.vert", "./boring.frag");
 Mesh g_linear("./linear_grating.vert", "./boring.frag");
+Mesh g_procedural("./procedural_grating.vert", "./procedural_grating.frag");
 //Mesh g_horz("./horzGrating.vert", "./boring.frag");
 
-// serial communication with arduino boards for synchronization and closed loop
-serial::Serial g_chan("/dev/ttyACM1", // closed-loop port
+// only drawn by the headless checks of the Renderer's per-object paths
+Mesh g_check("./boring.vert", "./boring.frag");
+
+// every GLSL program, shared between meshes and kept on disk between runs
+ProgramCache g_programs;
+
+// pattern of g_procedural, set per trial
+ProceduralGrating g_grating;
+
+// swarms of dots, all drawn from one copy of g_dot's geometry
+Mesh g_dot("./instanced_dots.vert", "./boring.frag");
+InstancedDots g_dots(1024);
+
+// per-pixel projection onto the curved screen, off unless -w is given
+WarpPass g_warp;
+bool g_warp_requested = false;
+
+// subframes per frame for DLP structured-light mode, 1 is off (-b)
+BitPlanePacker g_packer;
+int g_subframes_requested = 1;
+
+// one panorama split across several monitors, off unless -m is given
+DisplayOutputs g_displays;
+int g_outputs_requested = 1;
+
+// every mesh is drawn out of one shared arena, ~2 MB of vertices
+Renderer g_renderer(1 << 17, 1 << 18);
+
+// serial communication with arduino boards for synchronization and closed loop.
+// ports are opened in main() so they can be overridden on the command line
+serial::Serial g_chan("", // closed-loop port
                       8 * 115200, // baud rate
                       serial::Timeout::simpleTimeout(1000));
-serial::Serial g_sync_chan("/dev/ttyACM0", // synchonization port
+serial::Serial g_sync_chan("", // synchonization port
                            4 * 115200, // baud rate
                            serial::Timeout::simpleTimeout(1000));
 const uint8_t g_msg = 'a';
 bool g_serial_up = false;
 const uint8_t g_serial_flag = 255;
+const double g_serial_frame_rate = 8 * 115200 / 30.0; // nominal, limited by the line rate
+
+// reader thread that drains the closed-loop port; holds ~2 s of samples
+SerialReader g_reader(&g_chan, g_serial_flag, 1 << 16);
+
+// writer thread for the synchronization port, so a stuck write never
+// holds up a frame
+SyncPulser g_pulser(&g_sync_chan, g_msg, 1024);
 
 // Open-loop buffers
 // record of power for leftward trials
@@ -76,8 +153,8 @@ float g_raw_std_0 = 1; // std. dev. of raw data0
 float g_raw_mean_0 = 0; // mean of raw data0
 float g_raw_std_1 = 1; // std. dev. of raw data1
 float g_raw_mean_1 = 0; // mean of raw data1
-boost::circular_buffer<float> g_data0_ring(g_buffer_length); // raw data
-boost::circular_buffer<float> g_data1_ring(g_buffer_length); // raw data
+WindowStats g_data0_window(g_buffer_length); // raw data
+WindowStats g_data1_window(g_buffer_length); // raw data
 
 // closed-loop velocities:
 //      g_total_vel = g_stim_vel - g_fish_vel
@@ -86,25 +163,44 @@ float g_stim_vel = 0;
 float g_total_vel = 0;
 float g_pow0_cl = 0;
 float g_pow1_cl = 0;
-std::vector<float> g_fish_vel_record; // to save
-std::vector<float> g_stim_vel_record; // to save
-std::vector<float> g_total_vel_record; // to save
-//std::vector<float> g_pow0_cl_record; // to save
-//std::vector<float> g_pow1_cl_record; // to save
-//std::vector<float> g_raw0_cl_record; // to save
-//std::vector<float> g_raw1_cl_record; // to save
-
-// timing and state variables for updating the graphics
+RecordFile g_closed_loop_record(1024); // to save, streamed by a writer thread
+int g_time_ch, g_stim_vel_ch, g_fish_vel_ch, g_total_vel_ch;
+int g_pow0_ch, g_pow1_ch, g_raw0_ch, g_raw1_ch;
+
+// closed-loop latency: how old the newest ventral-root sample behind
+// the stimulus position is when the stimulus is updated and displayed
+double g_stim_sample_time = 0; // arrival of that sample, 0 outside trials
+double g_stim_update_time = 0;
+LatencyHistogram g_input_latency; // sample arrival -> stimulus update
+LatencyHistogram g_total_latency; // sample arrival -> swap complete
+int g_latency_trial = 0;
+int g_lat_trial_ch, g_lat_input_p50_ch, g_lat_input_p99_ch, g_lat_input_max_ch,
+    g_lat_total_p50_ch, g_lat_total_p99_ch, g_lat_total_max_ch;
+
+// per-frame timing of the game loops, ~70 min at 60 Hz
+FrameTimer g_frame_timer(1 << 18);
+
+// predicts when each frame reaches the screen
+VsyncClock g_vsync;
+
+// timing and state variables for updating the graphics. updates
+// compute the stimulus for g_present_time, when the frame being
+// rendered will be shown, and g_dt is the time since the last one
+double g_present_time = 0;
 double g_dt = 0;
 double g_total_elasped = 0;
-double g_elapsed_in_trial = 0;
-double g_trial_duration = 0;
+double g_elapsed_in_trial = 0; // since the stimulus came on, from g_timeline
+double g_trial_x0 = 0; // stimulus position and phase when the trial began
+double g_trial_phase0 = 0;
 
+int g_trial = -1; // counts trials across the whole session
 int g_curr_mode = -1;
 float g_curr_frequency = -1;
 float g_curr_speed = -1;
+float g_curr_speed_gl = -1;
 float g_curr_size = -1;
 float g_curr_gain = -1;
+int g_curr_count = -1;
 bool g_not_done = true;
 
 /************ GLFW callbacks ************************/
@@ -143,181 +239,133 @@ float std_dev_vec(std::vector<float>& buffer) {
     return sqrt(sum / (buffer.size() - 1));
 }
 
-float mean_ring(boost::circular_buffer<float>& buffer) {
-    
-    // computes mean value of a float ring buffer
-    
-    float sum = std::accumulate(buffer.begin(), buffer.end(), 0.0);
-    return sum / buffer.size();
-}
-
-float std_dev_ring(boost::circular_buffer<float>& buffer) {
-    
-    // computes std. deviation of data in a ring buffer
-    
-    float mean = mean_ring(buffer);
-    boost::circular_buffer<float>::iterator i = buffer.begin();
-    float sum = 0;
-    for (; i != buffer.end(); ++i) {
-        sum += ((*i) - mean) * ((*i) - mean);
-    }
-    
-    return sqrt(sum / (buffer.size() - 1));
-}
-
 void getSerialDataOpenLoop() {
-    // grabs and parses data from the arduino, storing
-    // data in two vectors (left and right ventral roots)
-    // for the appropriate stimulus type
-    
-    int ba = g_chan.available();
-    uint8_t data[ba];
-    g_chan.read(data, ba);
-    
-    // split data into two channels
-    int i = 0, i0 = 0, i1 = 0;
-    for (; data[i] != g_serial_flag; ++i) {} // find the first 0xFF flag in the data
-    switch (i) {
-        case 0:
-            // data = [0xFF, l, r, ...]
-            i0 = 1;
-            i1 = 2;
-            break;
-        case 1:
-            // data = [r, 0xFF, l, ...]
-            i0 = 2;
-            i1 = 0;
-            break;
-        case 2:
-            // data = [l, r, 0xFF, ...]
-            i0 = 0;
-            i1 = 1;
-            break;
-        default:
-            break;
-    }
+    // takes the samples the serial reader has decoded since the
+    // last frame, storing data in two vectors (left and right
+    // ventral roots) for the appropriate stimulus type
     
-    // put left and right data into vectors
+    std::vector<float>* data0;
+    std::vector<float>* data1;
     switch (g_curr_mode) {
         case 0:
-            for (; i0 < ba; i0 += 3) {
-                g_data0_rightward.push_back(data[i0]);
-            }
-            for (; i1 < ba; i1 += 3) {
-                g_data1_rightward.push_back(data[i1]);
-            }
+            data0 = &g_data0_rightward;
+            data1 = &g_data1_rightward;
             break;
-            
         case 1:
-            for (; i0 < ba; i0 += 3) {
-                g_data0_leftward.push_back(data[i0]);
-            }
-            for (; i1 < ba; i1 += 3) {
-                g_data1_leftward.push_back(data[i1]);
-            }
+            data0 = &g_data0_leftward;
+            data1 = &g_data1_leftward;
             break;
-            
         case 2:
-            for (; i0 < ba; i0 += 3) {
-                g_data0_forward.push_back(data[i0]);
-            }
-            for (; i1 < ba; i1 += 3) {
-                g_data1_forward.push_back(data[i1]);
-            }
+            data0 = &g_data0_forward;
+            data1 = &g_data1_forward;
             break;
-        
         default:
-            break;
+            g_reader.flush();
+            return;
+    }
+    
+    RootSample s;
+    while (g_reader.pop(&s)) {
+        data0->push_back(s.data0);
+        data1->push_back(s.data1);
     }
 }
 
 void getSerialDataClosedLoop() {
     
-    // grabs and parses data from the arduino, storing
-    // data in two ring buffers (left and right ventral roots)
-    
-    int ba = g_chan.available();
-    uint8_t data[ba];
-    g_chan.read(data, ba);
-    
-    // split data into two channels
-    int i = 0, i0 = 0, i1 = 0;
-    for (; data[i] != g_serial_flag; ++i) {} // find the first 0xFF flag in the data
-    switch (i) {
-        case 0:
-            // data = [0xFF, l, r, ...]
-            i0 = 1;
-            i1 = 2;
-            break;
-        case 1:
-            // data = [r, 0xFF, l, ...]
-            i0 = 2;
-            i1 = 0;
-            break;
-        case 2:
-            // data = [l, r, 0xFF, ...]
-            i0 = 0;
-            i1 = 1;
-            break;
-        default:
-            break;
-    }
+    // takes the samples the serial reader has decoded since the
+    // last frame, adding them to two sliding windows (left and right
+    // ventral roots)
     
-    // copy left and right data into ring buffers after scaling
-    for (; i0 < ba; i0 += 3) {
-        //g_raw0_cl_record.push_back(data[i0]);
-        g_data0_ring.push_back(((float)data[i0] - g_raw_mean_0) / g_raw_std_0);
-    }
-    for (; i1 < ba; i1 += 3) {
-        //g_raw1_cl_record.push_back(data[i1]);
-        g_data1_ring.push_back(((float)data[i1] - g_raw_mean_1) / g_raw_std_1);
+    RootSample s;
+    while (g_reader.pop(&s)) {
+        g_closed_loop_record.append(g_raw0_ch, &s.data0, 1);
+        g_closed_loop_record.append(g_raw1_ch, &s.data1, 1);
+        g_data0_window.push_back(s.data0);
+        g_data1_window.push_back(s.data1);
     }
 }
 
 void recordVelocity() {
-    g_stim_vel_record.push_back(g_stim_vel);
-    g_fish_vel_record.push_back(g_fish_vel);
-    g_total_vel_record.push_back(g_total_vel);
+    g_closed_loop_record.append(g_time_ch, g_total_elasped);
+    g_closed_loop_record.append(g_stim_vel_ch, g_stim_vel);
+    g_closed_loop_record.append(g_fish_vel_ch, g_fish_vel);
+    g_closed_loop_record.append(g_total_vel_ch, g_total_vel);
 }
 
-void writeVec(FILE* file, std::vector<float>& x) {
-    std::vector<float>::iterator i;
-    int j = 0;
-    for (i = x.begin(); i != x.end(); ++i) {
-        if (j == 0) {
-            fprintf(file, "%f", *i);
-            j = 1;
-        } else {
-            fprintf(file, ",%f", *i);
-        }
+void saveTrialLatency() {
+    if (g_total_latency.count() == 0) {
+        return;
     }
+    float input[3] = {
+        1000 * (float)g_input_latency.percentile(50),
+        1000 * (float)g_input_latency.percentile(99),
+        1000 * (float)g_input_latency.max()
+    };
+    float total[3] = {
+        1000 * (float)g_total_latency.percentile(50),
+        1000 * (float)g_total_latency.percentile(99),
+        1000 * (float)g_total_latency.max()
+    };
+    g_closed_loop_record.append(g_lat_trial_ch, &g_latency_trial, 1);
+    g_closed_loop_record.append(g_lat_input_p50_ch, input[0]);
+    g_closed_loop_record.append(g_lat_input_p99_ch, input[1]);
+    g_closed_loop_record.append(g_lat_input_max_ch, input[2]);
+    g_closed_loop_record.append(g_lat_total_p50_ch, total[0]);
+    g_closed_loop_record.append(g_lat_total_p99_ch, total[1]);
+    g_closed_loop_record.append(g_lat_total_max_ch, total[2]);
+    
+    printf("trial %d latency (ms): input p50 %.1f p99 %.1f max %.1f, "
+           "total p50 %.1f p99 %.1f max %.1f\n", g_latency_trial,
+           input[0], input[1], input[2], total[0], total[1], total[2]);
+    
+    g_latency_trial++;
+    g_input_latency.reset();
+    g_total_latency.reset();
 }
 
-void saveVelocity(char* fileid) {
+void openClosedLoopRecord(char* fileid) {
     char path[100];
     strcpy(path, fileid);
-    strcat(path, "_closed_loop_velocity.txt");
-    FILE* file = fopen(path, "w");
+    strcat(path, "_closed_loop.vrec");
+    
+    // one sample per frame
+    g_time_ch = g_closed_loop_record.addChannel("time", RECORD_FLOAT64, 0);
+    g_stim_vel_ch = g_closed_loop_record.addChannel("stim_vel", RECORD_FLOAT32, 0);
+    g_fish_vel_ch = g_closed_loop_record.addChannel("fish_vel", RECORD_FLOAT32, 0);
+    g_total_vel_ch = g_closed_loop_record.addChannel("total_vel", RECORD_FLOAT32, 0);
+    g_pow0_ch = g_closed_loop_record.addChannel("pow0", RECORD_FLOAT32, 0);
+    g_pow1_ch = g_closed_loop_record.addChannel("pow1", RECORD_FLOAT32, 0);
     
-    writeVec(file, g_stim_vel_record);
-    fprintf(file, "\n");
-    writeVec(file, g_fish_vel_record);
-    fprintf(file, "\n");
-    writeVec(file, g_total_vel_record);
-    //fprintf(file, "\n");
+    // every raw sample, about a second per chunk
+    g_raw0_ch = g_closed_loop_record.addChannel("raw0", RECORD_UINT8, g_serial_frame_rate, 1 << 15);
+    g_raw1_ch = g_closed_loop_record.addChannel("raw1", RECORD_UINT8, g_serial_frame_rate, 1 << 15);
     
-    //writeVec(file, g_pow0_cl_record);
-    //fprintf(file, "\n");
-    //writeVec(file, g_pow1_cl_record);
-    //fprintf(file, "\n");
+    // one sample per trial, in ms
+    g_lat_trial_ch = g_closed_loop_record.addChannel("latency_trial", RECORD_INT32, 0);
+    g_lat_input_p50_ch = g_closed_loop_record.addChannel("input_latency_p50", RECORD_FLOAT32, 0);
+    g_lat_input_p99_ch = g_closed_loop_record.addChannel("input_latency_p99", RECORD_FLOAT32, 0);
+    g_lat_input_max_ch = g_closed_loop_record.addChannel("input_latency_max", RECORD_FLOAT32, 0);
+    g_lat_total_p50_ch = g_closed_loop_record.addChannel("total_latency_p50", RECORD_FLOAT32, 0);
+    g_lat_total_p99_ch = g_closed_loop_record.addChannel("total_latency_p99", RECORD_FLOAT32, 0);
+    g_lat_total_max_ch = g_closed_loop_record.addChannel("total_latency_max", RECORD_FLOAT32, 0);
+    g_closed_loop_record.compress(g_raw0_ch);
+    g_closed_loop_record.compress(g_raw1_ch);
     
-    //writeVec(file, g_raw0_cl_record);
-    //fprintf(file, "\n");
-    //writeVec(file, g_raw1_cl_record);
-    //fprintf(file, "\n");
+    g_closed_loop_record.addParam("file_id", fileid);
+    g_closed_loop_record.addParam("raw_mean_0", g_raw_mean_0);
+    g_closed_loop_record.addParam("raw_std_0", g_raw_std_0);
+    g_closed_loop_record.addParam("raw_mean_1", g_raw_mean_1);
+    g_closed_loop_record.addParam("raw_std_1", g_raw_std_1);
+    g_closed_loop_record.addParam("pow0_threshold", g_pow0_threshold);
+    g_closed_loop_record.addParam("pow1_threshold", g_pow1_threshold);
+    g_closed_loop_record.addParam("bias", g_bias);
+    g_closed_loop_record.addParam("scale", g_scale);
+    g_closed_loop_record.addParam("window", g_buffer_length);
     
-    //fprintf(file, "%f,%f,%f,%f", g_raw_mean_0, g_raw_std_0, g_raw_mean_1, g_raw_std_1);
-    fclose(file);
+    // never stall the frame loop on the disk
+    g_closed_loop_record.setRealtime(true);
+    g_closed_loop_record.open(path);
 }
 
 unsigned int mymin(unsigned int a, unsigned int b) {
@@ -340,20 +388,40 @@ void normalizeVector(std::vector<float>& x, float& mean, float& std) {
 }
 
 void openLoopPower(std::vector<float>& x, std::vector<float>& p) {
-    boost::circular_buffer<float> win(g_buffer_length);
+    // windowed std. dev. of raw data, in a single pass
+    WindowStats win(g_buffer_length);
+    p.reserve(p.size() + x.size());
     std::vector<float>::iterator i;
     int j = 0;
     for (i = x.begin(); i != x.end(); ++i) {
-        win.push_back(*i);
-        if (j < 200) {
+        win.push_back((uint8_t)*i);
+        if (j < g_buffer_length) {
             p.push_back(0.0);
         } else {
-            p.push_back(std_dev_ring(win));
+            p.push_back(win.stdDev());
         }
         j++;
     }
 }
 
+typedef struct CalibrationChannel {
+    std::vector<float>* data; // raw data, normalized in place
+    float mean;
+    float std;
+    std::vector<float> power;
+} CalibrationChannel;
+
+void calibrateChannel(CalibrationChannel* c) {
+    // power of the raw data, then scale and de-mean the data. power of
+    // the normalized data is just the raw power over the std. dev.
+    openLoopPower(*c->data, c->power);
+    normalizeVector(*c->data, c->mean, c->std);
+    std::vector<float>::iterator i;
+    for (i = c->power.begin(); i != c->power.end(); ++i) {
+        *i /= c->std;
+    }
+}
+
 float getScale(std::vector<float>& left, std::vector<float>& right) {
     std::vector<float>::iterator i;
     float time_swimming_r = 0.0;
@@ -377,21 +445,31 @@ float getScale(std::vector<float>& left, std::vector<float>& right) {
 
 void prepareForClosedLoop(char* fileid, bool saveit) {
     
-    // first scale and de-mean raw data
-    float rightward_m_0, rightward_s_0,
-          rightward_m_1, rightward_s_1;
-    normalizeVector(g_data0_rightward, rightward_m_0, rightward_s_0);
-    normalizeVector(g_data1_rightward, rightward_m_1, rightward_s_1);
+    // scale and de-mean raw data and compute its power, one
+    // channel/direction per thread
+    const int n_channels = 6;
+    CalibrationChannel channels[n_channels];
+    channels[0].data = &g_data0_rightward;
+    channels[1].data = &g_data1_rightward;
+    channels[2].data = &g_data0_leftward;
+    channels[3].data = &g_data1_leftward;
+    channels[4].data = &g_data0_forward;
+    channels[5].data = &g_data1_forward;
     
-    float leftward_m_0, leftward_s_0,
-          leftward_m_1, leftward_s_1;
-    normalizeVector(g_data0_leftward, leftward_m_0, leftward_s_0);
-    normalizeVector(g_data1_leftward, leftward_m_1, leftward_s_1);
+    std::thread workers[n_channels];
+    for (int c = 0; c < n_channels; ++c) {
+        workers[c] = std::thread(calibrateChannel, &channels[c]);
+    }
+    for (int c = 0; c < n_channels; ++c) {
+        workers[c].join();
+    }
     
-    float forward_m_0, forward_s_0,
-          forward_m_1, forward_s_1;
-    normalizeVector(g_data0_forward, forward_m_0, forward_s_0);
-    normalizeVector(g_data1_forward, forward_m_1, forward_s_1);
+    float rightward_m_0 = channels[0].mean, rightward_s_0 = channels[0].std,
+          rightward_m_1 = channels[1].mean, rightward_s_1 = channels[1].std;
+    float leftward_m_0 = channels[2].mean, leftward_s_0 = channels[2].std,
+          leftward_m_1 = channels[3].mean, leftward_s_1 = channels[3].std;
+    float forward_m_0 = channels[4].mean, forward_s_0 = channels[4].std,
+          forward_m_1 = channels[5].mean, forward_s_1 = channels[5].std;
     
     // set global mean and std for raw data - used in closed loop
     g_raw_mean_0 = (leftward_m_0 + rightward_m_0 + forward_m_0) / 3;
@@ -399,16 +477,13 @@ void prepareForClosedLoop(char* fileid, bool saveit) {
     g_raw_mean_1 = (leftward_m_1 + rightward_m_1 + forward_m_1) / 3;
     g_raw_std_1 = (leftward_s_1 + rightward_s_1 + forward_s_1) / 3;
     
-    // now compute power of open-loop raw data
-    std::vector<float> pow0_rightward, pow1_rightward,
-                       pow0_leftward, pow1_leftward,
-                       pow0_forward, pow1_forward;
-    openLoopPower(g_data0_rightward, pow0_rightward);
-    openLoopPower(g_data1_rightward, pow1_rightward);
-    openLoopPower(g_data0_leftward, pow0_leftward);
-    openLoopPower(g_data1_leftward, pow1_leftward);
-    openLoopPower(g_data0_forward, pow0_forward);
-    openLoopPower(g_data1_forward, pow1_forward);
+    // power of open-loop data
+    std::vector<float>& pow0_rightward = channels[0].power;
+    std::vector<float>& pow1_rightward = channels[1].power;
+    std::vector<float>& pow0_leftward = channels[2].power;
+    std::vector<float>& pow1_leftward = channels[3].power;
+    std::vector<float>& pow0_forward = channels[4].power;
+    std::vector<float>& pow1_forward = channels[5].power;
     
     // compute power threshold
     float th_p0_rightward = mean_vec(pow0_rightward) + 2 * std_dev_vec(pow0_rightward);
@@ -468,66 +543,71 @@ void prepareForClosedLoop(char* fileid, bool saveit) {
     if (saveit) {
         char path[100];
         strcpy(path, fileid);
-        strcat(path, "_calibration_data.txt");
-        FILE* file = fopen(path, "w");
-        
-        // raw data
-        writeVec(file, g_data0_rightward);
-        fprintf(file, "\n");
-        writeVec(file, g_data1_rightward);
-        fprintf(file, "\n");
-        writeVec(file, g_data0_leftward);
-        fprintf(file, "\n");
-        writeVec(file, g_data1_leftward);
-        fprintf(file, "\n");
-        writeVec(file, g_data0_forward);
-        fprintf(file, "\n");
-        writeVec(file, g_data1_forward);
-        fprintf(file, "\n");
+        strcat(path, "_calibration_data.vrec");
+        RecordFile file(1 << 16);
         
-        // power
-        writeVec(file, pow0_rightward);
-        fprintf(file, "\n");
-        writeVec(file, pow1_rightward);
-        fprintf(file, "\n");
-        writeVec(file, pow0_leftward);
-        fprintf(file, "\n");
-        writeVec(file, pow1_leftward);
-        fprintf(file, "\n");
-        writeVec(file, pow0_forward);
-        fprintf(file, "\n");
-        writeVec(file, pow1_forward);
-        fprintf(file, "\n");
+        // raw data and power
+        const char* raw_names[n_channels] = {
+            "data0_rightward", "data1_rightward",
+            "data0_leftward", "data1_leftward",
+            "data0_forward", "data1_forward"
+        };
+        const char* pow_names[n_channels] = {
+            "pow0_rightward", "pow1_rightward",
+            "pow0_leftward", "pow1_leftward",
+            "pow0_forward", "pow1_forward"
+        };
+        int raw_ch[n_channels], pow_ch[n_channels];
+        for (int c = 0; c < n_channels; ++c) {
+            raw_ch[c] = file.addChannel(raw_names[c], RECORD_FLOAT32, g_serial_frame_rate);
+            pow_ch[c] = file.addChannel(pow_names[c], RECORD_FLOAT32, g_serial_frame_rate);
+        }
         
         // power difference
-        writeVec(file, dp_rightward);
-        fprintf(file, "\n");
-        writeVec(file, dp_leftward);
-        fprintf(file, "\n");
-        writeVec(file, dp_forward);
-        fprintf(file, "\n");
-    
+        int dp_rightward_ch = file.addChannel("dp_rightward", RECORD_FLOAT32, g_serial_frame_rate);
+        int dp_leftward_ch = file.addChannel("dp_leftward", RECORD_FLOAT32, g_serial_frame_rate);
+        int dp_forward_ch = file.addChannel("dp_forward", RECORD_FLOAT32, g_serial_frame_rate);
+        
         // power thresholds
-        fprintf(file, "%f,%f,%f,%f,%f,%f\n", th_p0_rightward, th_p1_rightward,
-                                             th_p0_leftward, th_p1_leftward,
-                                             th_p0_forward, th_p1_forward);
-        fprintf(file, "%f,%f\n", g_pow0_threshold, g_pow1_threshold);
+        file.addParam("th_p0_rightward", th_p0_rightward);
+        file.addParam("th_p1_rightward", th_p1_rightward);
+        file.addParam("th_p0_leftward", th_p0_leftward);
+        file.addParam("th_p1_leftward", th_p1_leftward);
+        file.addParam("th_p0_forward", th_p0_forward);
+        file.addParam("th_p1_forward", th_p1_forward);
+        file.addParam("pow0_threshold", g_pow0_threshold);
+        file.addParam("pow1_threshold", g_pow1_threshold);
         
         // bias and scale
-        fprintf(file, "%f,%f", g_bias, g_scale);
+        file.addParam("bias", g_bias);
+        file.addParam("scale", g_scale);
+        file.addParam("window", g_buffer_length);
         
-        fclose(file);
+        if (file.open(path)) {
+            for (int c = 0; c < n_channels; ++c) {
+                std::vector<float>& raw = *channels[c].data;
+                std::vector<float>& power = channels[c].power;
+                file.append(raw_ch[c], raw.data(), raw.size());
+                file.append(pow_ch[c], power.data(), power.size());
+            }
+            file.append(dp_rightward_ch, dp_rightward.data(), dp_rightward.size());
+            file.append(dp_leftward_ch, dp_leftward.data(), dp_leftward.size());
+            file.append(dp_forward_ch, dp_forward.data(), dp_forward.size());
+            if (!file.close()) {
+                printf("WARNING: calibration file %s is incomplete\n", path);
+            }
+        }
     }
 }
 
 void getFishVel() {
-    // compute power of ring buffers
-    g_pow0_cl = std_dev_ring(g_data0_ring);
-    g_pow1_cl = std_dev_ring(g_data1_ring);
+    // compute power of the raw data windows, scaled the same way
+    // as the open-loop data; de-meaning doesn't change the std. dev.
+    g_pow0_cl = g_data0_window.stdDev() / g_raw_std_0;
+    g_pow1_cl = g_data1_window.stdDev() / g_raw_std_1;
     
-    // debug
-    //g_pow0_cl_record.push_back(g_pow0_cl);
-    //g_pow1_cl_record.push_back(g_pow1_cl);
+    g_closed_loop_record.append(g_pow0_ch, g_pow0_cl);
+    g_closed_loop_record.append(g_pow1_ch, g_pow1_cl);
     
     // threshold power
     g_pow0_cl = (g_pow0_cl > g_pow0_threshold) ? g_pow0_cl : 0;
@@ -540,13 +620,6 @@ void getFishVel() {
 
 /************ rendering ************************/
 
-enum ATTRIBUTE_ID {
-    VERTEX_POSITION,
-    VERTEX_COLOR,
-    VERTEX_NORMAL,
-    VERTEX_TEXTURE
-};
-
 void checkMyGL() {
     GLenum gl_err = glGetError();
     if(gl_err != GL_NO_ERROR) {
@@ -556,53 +629,35 @@ void checkMyGL() {
 }
 
 void drawMesh(Mesh* mesh) {
-    glBindVertexArray(mesh->vao_);
-    glUseProgram(mesh->program_);
-    glUniformMatrix4fv(mesh->transform_matrix_location_, 1, GL_FALSE,
-                       mesh->transform_matrix_);
-    glDrawElements(GL_TRIANGLES, mesh->num_indices_,
-                   GL_UNSIGNED_SHORT, (const GLvoid*) 0);
+    // queued, g_renderer.flush() draws the whole frame
+    g_renderer.draw(mesh);
 }
 
-void initMeshShaders(Mesh* mesh) {
-    GLuint vs = initshaders(GL_VERTEX_SHADER, mesh->vertex_shader_path_);
-    GLuint fs = initshaders(GL_FRAGMENT_SHADER, mesh->fragment_shader_path_);
-    initprogram(mesh, vs, fs);
-    mesh->transform_matrix_location_ = glGetUniformLocation(mesh->program_, "transform_matrix");
+const char* flatVertexShader(const char* path) {
+    // shaders that project onto the screen themselves, and what to draw
+    // with instead when the warp pass does the projection
+    if (strcmp(path, "./rotating_grating.vert") == 0) {
+        return "./boring.vert";
+    }
+    if (strcmp(path, "./linear_grating.vert") == 0) {
+        return "./linear_grating_flat.vert";
+    }
+    return path;
 }
 
-void bufferMesh(Mesh* mesh) {
-    glGenBuffers(1, &(mesh->vertex_buffer_));
-    glGenBuffers(1, &(mesh->index_buffer_));
-    glGenVertexArrays(1, &(mesh->vao_));
-    
-    glBindVertexArray(mesh->vao_);
-    
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh->index_buffer_);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER,
-                 mesh->num_indices_ * sizeof(GLushort),
-                 mesh->indices_,
-                 GL_STATIC_DRAW);
-    
-    glBindBuffer(GL_ARRAY_BUFFER, mesh->vertex_buffer_);
-    glBufferData(GL_ARRAY_BUFFER,
-                 mesh->num_vertices_ * sizeof(Vertex2D),
-                 mesh->vertices_,
-                 GL_STATIC_DRAW);
-    
-    glEnableVertexAttribArray(VERTEX_POSITION);
-    glVertexAttribPointer(VERTEX_POSITION, 2, GL_FLOAT, GL_FALSE,
-                          sizeof(Vertex2D),
-                          (const GLvoid*) offsetof(Vertex2D, position));
-    
-    glEnableVertexAttribArray(VERTEX_COLOR);
-    glVertexAttribPointer(VERTEX_COLOR, 4, GL_UNSIGNED_BYTE, GL_FALSE,
-                          sizeof(Vertex2D),
-                          (const GLvoid*) offsetof(Vertex2D, color));
+// whether stimuli are drawn in flat visual-angle space and projected
+// afterwards, rather than straight onto the curved screen
+bool flatScene() {
+    return g_warp.enabled() || g_displays.enabled();
+}
 
-    glBindVertexArray(0);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+void initMeshShaders(Mesh* mesh) {
+    if (flatScene()) {
+        mesh->vertex_shader_path_ = flatVertexShader(mesh->vertex_shader_path_);
+    }
+    mesh->program_ = g_programs.program(mesh->vertex_shader_path_,
+                                        mesh->fragment_shader_path_);
+    g_renderer.bindProgram(mesh->program_);
 }
 
 /***************** Draw functions for specific experiments *****************/
@@ -620,289 +675,346 @@ void drawOpenLoopPrey() {
     drawMesh(&g_prey);
 }
 
+void drawPreySwarm() {
+    drawMesh(&g_background);
+    g_dots.draw(g_elapsed_in_trial);
+}
+
 void drawClosedLoopOMR() {
     drawMesh(&g_rotating);
 }
 
+void drawGratingSweep() {
+    drawMesh(&g_procedural);
+}
+
 /*********** Experiment set-up and update ************************/
 float velToGL(float vel) {
     return SCREEN_WIDTH_GL * (vel / SCREEN_WIDTH_DEG);
 }
 
-void updateOpenLoopPrey() {
-    if (g_elapsed_in_trial <= g_trial_duration) {
-        
-        // trial is not done yet
-        g_prey.translateX(-g_curr_speed * g_dt);
-        g_elapsed_in_trial += g_dt;
-        
-        if (!g_serial_up) {
-            g_sync_chan.write(&g_msg, 1);
-            g_serial_up = true;
-        }
-        
-    } else if (g_elapsed_in_trial <= g_trial_duration + 10) {
-        // inter-trial period (10 s)
-        g_elapsed_in_trial += g_dt;
-        g_prey.centerXY(2, -0.02); // move mesh off-screen
-        
-        if (g_serial_up) {
-            g_sync_chan.write(&g_msg, 1);
-            g_serial_up = !g_serial_up;
-        }
-        
-    } else {
-        // start a new trial
-        g_curr_speed = g_protocol.nextSpeed();
-        g_curr_size = g_protocol.nextSize();
-        
-        if (g_curr_speed < 0 || g_curr_size < 0) { // end of protocol
-            g_not_done = false;
-        } else {
-            g_trial_duration = SCREEN_WIDTH_GL / g_curr_speed;
-            g_elapsed_in_trial = 0;
-            g_prey.resetScale();
-            g_prey.scaleXY(g_curr_size);
-            g_prey.centerXY(SCREEN_EDGE_GL, -0.05);
-            
-            if (!g_serial_up) {
-                g_sync_chan.write(&g_msg, 1);
-                g_serial_up = !g_serial_up;
-            }
-        }
+int trialForFrame() {
+    // -1 outside the stimulus period of a trial
+    return g_timeline.stimulusOn() ? g_trial : -1;
+}
+
+void loadTrial(int row) {
+    // copies a row of the trial table into the current parameters
+    g_row = row;
+    g_curr_mode = g_table->mode[g_row];
+    g_curr_speed = g_table->speed[g_row];
+    g_curr_speed_gl = g_table->speed_gl[g_row];
+    g_curr_size = g_table->size_gl[g_row];
+    g_curr_gain = g_table->gain[g_row];
+    g_curr_frequency = g_table->frequency[g_row];
+    g_curr_count = g_table->count[g_row];
+}
+
+void startProtocol(const Protocol& protocol, double lead_in) {
+    // lays out the protocol's session, g_timeline.start() sets it going
+    g_table = &protocol.table();
+    g_row = -1;
+    g_timeline.build(protocol.table(), lead_in);
+}
+
+void setSync(bool up) {
+    // the synchronization board toggles on every byte. the edge is
+    // logged against the time this frame will be shown. a dropped pulse
+    // leaves g_serial_up as the line really is, so the next call retries
+    // instead of inverting the line for the rest of the session
+    if (up != g_serial_up && g_pulser.submit(up, g_trial, g_present_time)) {
+        g_serial_up = up;
     }
 }
 
-void updateOpenLoopStepOMR() {
-    if (g_elapsed_in_trial <= g_trial_duration) {
-        
-        // trial is not done yet
-        float coeff = (g_curr_mode == 0) ? -1 : 1;
-        g_linear.translateXmod(coeff * velToGL(g_curr_speed) * g_dt, SCREEN_WIDTH_GL);
-        g_rotating.translateXmod(coeff * velToGL(g_curr_speed) * g_dt, SCREEN_WIDTH_GL);
-        g_elapsed_in_trial += g_dt;
-        
-        if (!g_serial_up) {
-            g_sync_chan.write(&g_msg, 1);
-            g_serial_up = true;
+void updateTimeline() {
+    // fires the events due by the time this frame is shown, then
+    // updates the stimulus for that time
+    TimelineEvent e;
+    while (g_timeline.next(g_present_time, &e)) {
+        switch (e.type) {
+            case EVENT_PARAMETERS:
+                loadTrial(e.trial);
+                g_trial++;
+                break;
+            case EVENT_STIMULUS_ON:
+                g_stimulus_frames = 0;
+                if (g_handlers.start) {
+                    g_handlers.start();
+                }
+                break;
+            case EVENT_STIMULUS_OFF:
+                if (g_handlers.stop) {
+                    g_handlers.stop();
+                }
+                if (g_stimulus_frames == 0) {
+                    // on and off both fell due before this frame
+                    printf("trial %d was never shown, a frame came too late\n", g_trial);
+                    g_frame_timer.lostTrial(g_trial);
+                    g_lost_trials++;
+                }
+                break;
+            case EVENT_SYNC_HIGH:
+                setSync(true);
+                break;
+            case EVENT_SYNC_LOW:
+                setSync(false);
+                break;
+            case EVENT_END:
+                g_not_done = false;
+                break;
         }
-        
-    } else if (g_elapsed_in_trial <= g_trial_duration + 10) {
-        
-        // inter-trial period (10 s)
-        g_elapsed_in_trial += g_dt;
-        
-        if (g_serial_up) {
-            g_sync_chan.write(&g_msg, 1);
-            g_serial_up = false;
-        }
-        
+    }
+    
+    g_elapsed_in_trial = g_timeline.elapsed(g_present_time);
+    if (g_timeline.stimulusOn()) {
+        g_stimulus_frames++;
+        g_handlers.update();
+    } else if (g_handlers.between && g_timeline.trial() >= 0) {
+        g_handlers.between();
     } else {
-        
-        g_curr_speed = g_protocol.nextSpeed();
-        g_curr_mode = g_protocol.nextMode();
-        
-        if (g_curr_speed < 0 || g_curr_mode < 0) {
-            // end of protocol
-            g_not_done = false;
-        } else {
-            // start a new trial
-            g_elapsed_in_trial = 0;
-            g_sync_chan.write(&g_msg, 1);
-            g_serial_up = true;
-        }
+        g_reader.flush(); // nothing consumes samples outside trials
     }
 }
 
-void updateClosedLoopStepOMR() {
-    if (g_elapsed_in_trial <= g_trial_duration) {
-        
-        // trial is not done yet
-        float coeff = (g_curr_mode == 0) ? -1 : 1;
-        
-        getSerialDataClosedLoop();
-        getFishVel();
-        
-        g_stim_vel = coeff * g_curr_speed;
-        g_total_vel = g_stim_vel - (g_curr_gain * g_fish_vel);
-        
-        recordVelocity();
-        
-        g_rotating.translateXmod(velToGL(g_total_vel) * g_dt, SCREEN_WIDTH_GL);
-        g_elapsed_in_trial += g_dt;
-        
-        if (!g_serial_up) {
-            g_sync_chan.write(&g_msg, 1);
-            g_serial_up = true;
-        }
-        
-    } else if (g_elapsed_in_trial <= g_trial_duration + 10) {
-        
-        // inter-trial period (10 s)
-        g_elapsed_in_trial += g_dt;
-        
-        g_stim_vel = 0;
-        g_fish_vel = 0;
-        g_total_vel = 0;
-        recordVelocity();
-        
-        if (g_serial_up) {
-            g_sync_chan.write(&g_msg, 1);
-            g_serial_up = false;
-        }
-        
-    } else {
-        
-        g_curr_speed = g_protocol.nextSpeed();
-        g_curr_gain = g_protocol.nextGain();
-        g_curr_mode = g_protocol.nextMode();
-        recordVelocity();
-        
-        if (g_curr_speed < 0 || g_curr_mode < 0) {
-            // end of protocol
-            g_not_done = false;
-            
-        } else {
-            // start a new trial
-            g_elapsed_in_trial = 0;
-            g_sync_chan.write(&g_msg, 1);
-            g_serial_up = true;
-        }
+void startPrey() {
+    g_prey.resetScale();
+    g_prey.scaleXY(g_curr_size);
+    g_prey.centerXY(SCREEN_EDGE_GL, -0.05);
+}
+
+void updatePrey() {
+    g_prey.setX(SCREEN_EDGE_GL - g_curr_speed_gl * g_elapsed_in_trial);
+}
+
+void stopPrey() {
+    g_prey.centerXY(2, -0.02); // move mesh off-screen
+}
+
+void layoutSwarm(int count, float size, float speed, uint64_t seed) {
+    // the same seed always gives the same swarm. positions fall on a
+    // 2^-24 grid, which a float holds exactly
+    Random random(seed);
+    const float steps = 1 << 24;
+    g_dots.clear();
+    for (int i = 0; i < count; ++i) {
+        DotInstance dot;
+        float direction = random.below(2) ? 1 : -1;
+        dot.position[0] = SCREEN_WIDTH_GL * (random.below(1 << 24) / steps) - SCREEN_EDGE_GL;
+        dot.position[1] = 0.25 * (random.below(1 << 24) / steps) - 0.15;
+        dot.velocity[0] = direction * velToGL(speed);
+        dot.velocity[1] = 0;
+        dot.size = size;
+        dot.color[0] = 0;
+        dot.color[1] = 0;
+        dot.color[2] = 0;
+        dot.color[3] = 255;
+        g_dots.add(dot);
     }
+    g_dots.upload(0);
+}
+
+void startPreySwarm() {
+    // from the session seed, so the recorded seed reproduces the swarms
+    // too. the trial goes in the high word so no trial reuses the seed
+    // the trial order came from
+    layoutSwarm(g_curr_count, g_curr_size, g_curr_speed,
+                g_protocol.seed() ^ ((uint64_t)(g_trial + 1) << 32));
+}
+
+void updatePreySwarm() {
+    // the dots move on the GPU
+}
+
+void stopPreySwarm() {
+    g_dots.clear();
+    g_dots.upload(0);
+}
+
+void startStepOMR() {
+    g_trial_x0 = g_rotating.transform_matrix_[12];
+}
+
+void updateStepOMR() {
+    float coeff = (g_curr_mode == 0) ? -1 : 1;
+    double x = g_trial_x0 + coeff * g_curr_speed_gl * g_elapsed_in_trial;
+    g_linear.setXmod(x, SCREEN_WIDTH_GL);
+    g_rotating.setXmod(x, SCREEN_WIDTH_GL);
+}
+
+void startGratingSweep() {
+    // only a uniform changes
+    g_grating.setFrequency(g_curr_frequency);
+    g_trial_phase0 = g_grating.phase();
+}
+
+void updateGratingSweep() {
+    float coeff = (g_curr_mode == 0) ? -1 : 1;
+    g_grating.setPhase(g_trial_phase0 +
+                       g_curr_frequency * coeff * g_curr_speed * g_elapsed_in_trial);
 }
 
 void updateCalibrationStepOMR() {
-    if (g_elapsed_in_trial <= g_trial_duration) {
-        
-        // trial is not done yet
-        float coeff = (g_curr_mode == 0) ? -1 : 1;
-        g_linear.translateXmod(coeff * velToGL(g_curr_speed) * g_dt, SCREEN_WIDTH_GL);
-        g_rotating.translateXmod(coeff * velToGL(g_curr_speed) * g_dt, SCREEN_WIDTH_GL);
-        g_elapsed_in_trial += g_dt;
-        
-        if (!g_serial_up) {
-            g_sync_chan.write(&g_msg, 1);
-            g_serial_up = true;
-        }
-        
-        getSerialDataOpenLoop();
-        
-    } else if (g_elapsed_in_trial <= g_trial_duration + 10) {
-        
-        // inter-trial period (10 s)
-        g_elapsed_in_trial += g_dt;
-        
-        if (g_serial_up) {
-            g_sync_chan.write(&g_msg, 1);
-            g_serial_up = false;
-        }
-        
-    } else {
-        
-        g_curr_speed = g_calibration_protocol.nextSpeed();
-        g_curr_mode = g_calibration_protocol.nextMode();
-        
-        if (g_curr_speed < 0 || g_curr_mode < 0) {
-            // end of protocol
-            g_not_done = false;
-        } else {
-            // start a new trial
-            g_elapsed_in_trial = 0;
-            g_sync_chan.write(&g_msg, 1);
-            g_serial_up = true;
-        }
-    }
+    updateStepOMR();
+    getSerialDataOpenLoop();
+}
+
+void updateClosedLoopStepOMR() {
+    float coeff = (g_curr_mode == 0) ? -1 : 1;
+    
+    getSerialDataClosedLoop();
+    getFishVel();
+    g_stim_sample_time = g_reader.lastArrival();
+    g_stim_update_time = monotonicTime();
+    
+    g_stim_vel = coeff * g_curr_speed;
+    g_total_vel = g_stim_vel - (g_curr_gain * g_fish_vel);
+    
+    recordVelocity();
+    
+    // the fish's feedback is integrated, so this one steps with g_dt
+    g_rotating.translateXmod(velToGL(g_total_vel) * g_dt, SCREEN_WIDTH_GL);
 }
 
-void setupExperiment(int type, char* fileid) {
+void stopClosedLoopStepOMR() {
+    g_stim_sample_time = 0;
+    saveTrialLatency();
+    g_closed_loop_record.flush(); // a crash loses at most the current trial
+}
+
+void betweenClosedLoopStepOMR() {
+    g_reader.flush();
+    g_stim_vel = 0;
+    g_fish_vel = 0;
+    g_total_vel = 0;
+    recordVelocity();
+}
+
+void buildScene(int type) {
+    // meshes and shaders for an experiment type, without its protocol
     switch (type) {
         case OPEN_LOOP_OMR:
+        case CLOSED_LOOP_OMR:
         {
             g_rotating.rotatingGrating(8);
             g_rotating.scaleX(SCREEN_EDGE_GL);
             g_rotating.scaleY(0.3);
-            bufferMesh(&g_rotating);
+            g_renderer.add(&g_rotating);
             initMeshShaders(&g_rotating);
             
             g_linear.linearGrating(8);
             g_linear.scaleX(SCREEN_EDGE_GL);
             g_linear.scaleY(0.3);
-            bufferMesh(&g_linear);
+            g_renderer.add(&g_linear);
             initMeshShaders(&g_linear);
             
-            char path[100];
-            strcpy(path, fileid);
-            strcat(path, "_openloop.txt");
-            g_protocol.createOpenLoopStepOMR(true, path);
-            
-            g_curr_speed = g_protocol.nextSpeed();
-            g_curr_mode = g_protocol.nextMode();
-            g_trial_duration = 10;
-            
-            g_updateFunc = &updateOpenLoopStepOMR;
-            g_drawFunc = &drawOpenLoopOMR;
-            
             break;
         }
+        case OPEN_LOOP_PREY_SWARM:
+        {
+            g_dot.circle(1, 0, 0);
+            initMeshShaders(&g_dot);
+            g_dots.init(&g_dot, SCREEN_WIDTH_GL);
+        }
+        // fall through, swarms move over the prey scene's background
         case OPEN_LOOP_PREY:
         {
             g_background.rotatingGrating(8);
             g_background.scaleX(SCREEN_EDGE_GL);
             g_background.scaleY(0.3);
             g_background.translateZ(0.001);
-            bufferMesh(&g_background);
+            g_renderer.add(&g_background);
             initMeshShaders(&g_background);
             
             g_prey.circle(1, 0, 0);
             g_prey.color(0, 0, 0, 255);
-            bufferMesh(&g_prey);
+            g_renderer.add(&g_prey);
             initMeshShaders(&g_prey);
             
+            break;
+        }
+        case OPEN_LOOP_GRATING_SWEEP:
+        {
+            g_procedural.rect(-1, -1, 1, 1);
+            g_procedural.color(0, 0, 150, 255);
+            g_procedural.scaleX(SCREEN_EDGE_GL);
+            g_procedural.scaleY(0.3);
+            g_renderer.add(&g_procedural);
+            initMeshShaders(&g_procedural);
+            g_grating.init(g_procedural.program_, SCREEN_WIDTH_DEG);
+            g_grating.setCylinder(!flatScene());
+            
+            break;
+        }
+    }
+}
+
+void createProtocol(Protocol* protocol, const ProtocolDesign& design, char* path) {
+    if (!protocol->create(design, true, path)) {
+        exit(EXIT_FAILURE);
+    }
+    printf("%s: %d trials, seed %llu\n", design.name, protocol->length(),
+           (unsigned long long)protocol->seed());
+}
+
+void setupExperiment(int type, char* fileid, const ProtocolDesign& design) {
+    switch (type) {
+        case OPEN_LOOP_OMR:
+        {
+            buildScene(type);
+            
             char path[100];
             strcpy(path, fileid);
-            strcat(path, "_openloop.txt");
-            g_protocol.createOpenLoopPrey(true, path);
+            strcat(path, "_openloop.vrec");
+            createProtocol(&g_protocol, design, path);
+            startProtocol(g_protocol, g_lead_in);
+            
+            g_handlers.start = &startStepOMR;
+            g_handlers.update = &updateStepOMR;
+            g_drawFunc = &drawOpenLoopOMR;
+            
+            break;
+        }
+        case OPEN_LOOP_PREY:
+        {
+            buildScene(type);
             
-            g_curr_speed = g_protocol.nextSpeed();
-            g_curr_size = g_protocol.nextSize();
-            g_prey.scaleXY(g_curr_size);
-            g_prey.centerXY(SCREEN_EDGE_GL, -0.02);
+            char path[100];
+            strcpy(path, fileid);
+            strcat(path, "_openloop.vrec");
+            createProtocol(&g_protocol, design, path);
+            startProtocol(g_protocol, g_lead_in);
+            stopPrey(); // off-screen until the first trial
             
-            g_updateFunc = &updateOpenLoopPrey;
+            g_handlers.start = &startPrey;
+            g_handlers.update = &updatePrey;
+            g_handlers.stop = &stopPrey;
             g_drawFunc = &drawOpenLoopPrey;
             
             break;
         }
         case CLOSED_LOOP_OMR:
         {
-            g_rotating.rotatingGrating(8);
-            g_rotating.scaleX(SCREEN_EDGE_GL);
-            g_rotating.scaleY(0.3);
-            bufferMesh(&g_rotating);
-            initMeshShaders(&g_rotating);
-            
-            g_linear.linearGrating(8);
-            g_linear.scaleX(SCREEN_EDGE_GL);
-            g_linear.scaleY(0.3);
-            bufferMesh(&g_linear);
-            initMeshShaders(&g_linear);
-            
+            buildScene(type);
             
             char path1[100];
             strcpy(path1, fileid);
-            strcat(path1, "_openloop.txt");
-            g_calibration_protocol.createOpenLoopStepOMR(true, path1);
+            strcat(path1, "_openloop.vrec");
+            ProtocolDesign calibration;
+            Protocol::builtin(OPEN_LOOP_OMR, &calibration);
+            calibration.seeded = true;
+            calibration.seed = design.seed + 1; // its own sequence, same session seed
+            createProtocol(&g_calibration_protocol, calibration, path1);
             
             char path2[100];
             strcpy(path2, fileid);
-            strcat(path2, "_closedloop.txt");
-            g_protocol.createClosedLoopStepOMR(true, path2);
+            strcat(path2, "_closedloop.vrec");
+            createProtocol(&g_protocol, design, path2);
             
-            g_curr_speed = g_calibration_protocol.nextSpeed();
-            g_curr_mode = g_calibration_protocol.nextMode();
-            g_trial_duration = 10;
+            startProtocol(g_calibration_protocol, g_lead_in);
             
-            g_updateFunc = &updateCalibrationStepOMR;
+            g_handlers.start = &startStepOMR;
+            g_handlers.update = &updateCalibrationStepOMR;
             g_drawFunc = &drawOpenLoopOMR;
 
             break;
@@ -910,6 +1022,40 @@ void setupExperiment(int type, char* fileid) {
         case CLOSED_LOOP_PREY:
             break;
             
+        case OPEN_LOOP_GRATING_SWEEP:
+        {
+            buildScene(type);
+            
+            char path[100];
+            strcpy(path, fileid);
+            strcat(path, "_openloop.vrec");
+            createProtocol(&g_protocol, design, path);
+            startProtocol(g_protocol, g_lead_in);
+            
+            g_handlers.start = &startGratingSweep;
+            g_handlers.update = &updateGratingSweep;
+            g_drawFunc = &drawGratingSweep;
+            
+            break;
+        }
+        case OPEN_LOOP_PREY_SWARM:
+        {
+            buildScene(type);
+            
+            char path[100];
+            strcpy(path, fileid);
+            strcat(path, "_openloop.vrec");
+            createProtocol(&g_protocol, design, path);
+            startProtocol(g_protocol, g_lead_in);
+            
+            g_handlers.start = &startPreySwarm;
+            g_handlers.update = &updatePreySwarm;
+            g_handlers.stop = &stopPreySwarm;
+            g_drawFunc = &drawPreySwarm;
+            
+            break;
+        }
+            
         default:
         {
             printf("Unrecognized experiment type!\n");
@@ -919,10 +1065,425 @@ void setupExperiment(int type, char* fileid) {
     }
 }
 
+/************ game loop ************************/
+
+void renderFrame(void (*update)()) {
+    // updates the stimulus for when this frame will be shown, so a late
+    // frame doesn't shift the ones after it, then draws it. when packing
+    // bit planes, the subframes are shown in turn across one refresh
+    // period and each gets its own update and draw
+    double present = g_vsync.predict();
+    int n = g_packer.subframes();
+    bool packed = n > 1;
+    
+    if (packed) {
+        g_frame_timer.beginDraw();
+    }
+    for (int k = 0; k < n; ++k) {
+        double t = present + k * g_vsync.period() / n;
+        g_dt = t - g_present_time;
+        g_present_time = t;
+        g_total_elasped += g_dt;
+        
+        g_frame_timer.beginUpdate();
+        update();
+        g_frame_timer.endUpdate();
+        
+        g_packer.beginSubframe(k);
+        g_warp.begin();
+        g_displays.begin();
+        glClear(GL_COLOR_BUFFER_BIT|GL_DEPTH_BUFFER_BIT);
+        
+        if (!packed) {
+            g_frame_timer.beginDraw();
+        }
+        g_drawFunc();
+        g_renderer.flush();
+        g_warp.end();
+        if (!packed) {
+            g_frame_timer.endDraw();
+        }
+        g_packer.endSubframe(k);
+    }
+    if (packed) {
+        g_frame_timer.endDraw();
+    }
+}
+
+void presentFrame(GLFWwindow* window) {
+    if (g_displays.enabled()) {
+        g_displays.present();
+    } else {
+        glfwSwapBuffers(window);
+    }
+}
+
 /************ main ************************/
 
+typedef struct BenchScene {
+    const char* name;
+    void (*draw)();
+    void (*step)(double dt); // deterministic motion, so frames are reproducible
+} BenchScene;
+
+void benchStepOMR(double dt) {
+    g_linear.translateXmod(velToGL(10) * dt, SCREEN_WIDTH_GL);
+    g_rotating.translateXmod(velToGL(10) * dt, SCREEN_WIDTH_GL);
+}
+
+void benchStepPrey(double dt) {
+    g_prey.translateXmod(-velToGL(90) * dt, SCREEN_EDGE_GL);
+}
+
+void benchStepGrating(double dt) {
+    g_grating.advance(10 * dt);
+}
+
+void benchStepSwarm(double dt) {
+    g_elapsed_in_trial += dt;
+}
+
+void drawBenchOMRForward() {
+    g_curr_mode = 2;
+    drawOpenLoopOMR();
+}
+
+void readFramebuffer(GLuint fbo, int width, int height, std::vector<uint8_t>& rgba) {
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, fbo);
+    glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, rgba.data());
+}
+
+bool checkPixel(const std::vector<uint8_t>& rgba, int width, float fx, float fy,
+                const float expected[3], const char* what) {
+    // one channel may be off by a rounding step either way
+    int x = fx * width;
+    int y = fy * (rgba.size() / (4 * width));
+    const uint8_t* p = &rgba[4 * (y * width + x)];
+    bool ok = true;
+    for (int k = 0; k < 3; ++k) {
+        ok = ok && fabs(p[k] - 255 * expected[k]) <= 1.5;
+    }
+    if (!ok) {
+        printf("%-18s %s: got %d %d %d, expected %.0f %.0f %.0f\n", "", what,
+               p[0], p[1], p[2], 255 * expected[0], 255 * expected[1], 255 * expected[2]);
+    }
+    return ok;
+}
+
+bool checkRenderer(const HeadlessContext& context, std::vector<uint8_t>& rgba) {
+    // draws g_check straight into the context's framebuffer and reads
+    // it back: first a two-color rect with tint, contrast and
+    // luminance applied in the shader, then a circle rebuilt into the
+    // rect's arena slot with Renderer::update()
+    const int width = context.width();
+    const int height = context.height();
+    glBindFramebuffer(GL_FRAMEBUFFER, context.framebuffer());
+    glViewport(0, 0, width, height);
+    
+    // the lower right triangle takes vertex 2's color and the upper
+    // left vertex 3's, so the rect's mean is halfway between them
+    const float a[3] = {200 / 255.0f, 40 / 255.0f, 120 / 255.0f};
+    const float b[3] = {40 / 255.0f, 160 / 255.0f, 80 / 255.0f};
+    const float tint[3] = {1, 0.5, 0.75};
+    const float contrast = 0.5;
+    const float luminance = 0.8;
+    g_check.setTint(tint[0], tint[1], tint[2], 1);
+    g_check.setContrast(contrast);
+    g_check.setLuminance(luminance);
+    
+    glClear(GL_COLOR_BUFFER_BIT|GL_DEPTH_BUFFER_BIT);
+    g_renderer.draw(&g_check);
+    g_renderer.flush();
+    readFramebuffer(context.framebuffer(), width, height, rgba);
+    
+    float expect_a[3], expect_b[3];
+    for (int k = 0; k < 3; ++k) {
+        float mean = (a[k] + b[k]) / 2;
+        expect_a[k] = tint[k] * luminance * (mean + contrast * (a[k] - mean));
+        expect_b[k] = tint[k] * luminance * (mean + contrast * (b[k] - mean));
+    }
+    bool modulation_ok = checkPixel(rgba, width, 0.75, 0.25, expect_a, "lower right") &&
+                         checkPixel(rgba, width, 0.25, 0.75, expect_b, "upper left");
+    printf("%-18s tint, contrast and luminance %s\n", "modulation", modulation_ok ? "ok" : "wrong");
+    
+    g_check.setTint(1, 1, 1, 1);
+    g_check.setContrast(1);
+    g_check.setLuminance(1);
+    g_check.circle(0.5, 0, 0);
+    g_check.color(255, 255, 255, 255);
+    bool update_ok = g_renderer.update(&g_check);
+    if (update_ok) {
+        glClear(GL_COLOR_BUFFER_BIT|GL_DEPTH_BUFFER_BIT);
+        g_renderer.draw(&g_check);
+        g_renderer.flush();
+        readFramebuffer(context.framebuffer(), width, height, rgba);
+        const float white[3] = {1, 1, 1};
+        const float black[3] = {0, 0, 0};
+        update_ok = checkPixel(rgba, width, 0.5, 0.5, white, "circle center") &&
+                    checkPixel(rgba, width, 0.1, 0.1, black, "outside circle");
+    }
+    printf("%-18s geometry rebuilt in place %s\n", "arena update", update_ok ? "ok" : "wrong");
+    return modulation_ok && update_ok;
+}
+
+bool checkDecoder() {
+    // joins a stream mid-frame while channel 1 is saturated at the flag
+    // value, then lets it come down. the decoder must not lock on to the
+    // channel 1 offset, and every frame it returns must be in order
+    const uint8_t flag = 0xFF;
+    const int n_frames = 200;
+    std::vector<uint8_t> stream;
+    for (int i = 0; i < n_frames; ++i) {
+        stream.push_back(flag);
+        stream.push_back(10 + i % 50);
+        stream.push_back((i < n_frames / 2) ? flag : i % 50);
+    }
+    FrameDecoder decoder(flag);
+    std::vector<RootSample> out(stream.size() / 3 + 1);
+    size_t m = 0;
+    for (size_t start = 1; start < stream.size(); start += 7) {
+        size_t n = std::min<size_t>(7, stream.size() - start);
+        m += decoder.decode(&stream[start], n, &out[m]);
+    }
+    
+    // the stream ends on a whole frame, so out holds the last m of them
+    bool ok = (m > 0) && (decoder.malformed() == 0);
+    for (size_t k = 0; k < m && ok; ++k) {
+        int i = n_frames - m + k;
+        ok = (out[k].data0 == 10 + i % 50) &&
+             (out[k].data1 == ((i < n_frames / 2) ? flag : i % 50));
+    }
+    printf("%-18s saturated channel joined mid-frame %s (%zu of %d frames)\n",
+           "frame decoder", ok ? "ok" : "wrong", m, n_frames);
+    return ok;
+}
+
+int runHeadless(int frames, const char* fileid) {
+    // renders each stimulus type to an offscreen target as fast as
+    // possible, reporting throughput and a checksum of the last frame.
+    // with a file id, the last frames are also saved as images
+    HeadlessContext context;
+    if (!context.create(1280, 720)) {
+        return EXIT_FAILURE;
+    }
+    glEnable(GL_DEPTH_TEST);
+    glEnable(GL_CULL_FACE);
+    
+    double shader_start = monotonicTime();
+    g_programs.init("./shader_cache");
+    if (g_warp_requested) {
+        g_warp.init(g_programs.program("./warp.vert", "./warp.frag"),
+                    context.width(), context.height(), SCREEN_WIDTH_GL / 2);
+        g_warp.setOutput(context.framebuffer());
+    }
+    if (g_subframes_requested > 1) {
+        g_packer.init(g_programs.program("./warp.vert", "./bitplane.frag"),
+                      context.width(), context.height(), g_subframes_requested);
+        g_packer.setOutput(context.framebuffer());
+        g_warp.setOutput(g_packer.framebuffer());
+    }
+    g_renderer.init();
+    buildScene(OPEN_LOOP_OMR);
+    buildScene(OPEN_LOOP_PREY_SWARM); // and the prey scene
+    buildScene(OPEN_LOOP_GRATING_SWEEP);
+    g_check.reserve(64, 192); // a circle fits in the rect's slot
+    g_check.rect(-1, -1, 1, 1);
+    g_check.color(0, 0, 0, 255);
+    for (int k = 0; k < 3; ++k) {
+        g_check.vertices_[2].color[k] = (k == 0) ? 200 : (k == 1) ? 40 : 120;
+        g_check.vertices_[3].color[k] = (k == 0) ? 40 : (k == 1) ? 160 : 80;
+    }
+    g_renderer.add(&g_check);
+    initMeshShaders(&g_check);
+    g_renderer.upload();
+    g_programs.releaseShaders();
+    printf("shader programs: %d compiled, %d from cache in %.1f ms\n",
+           g_programs.compiled(), g_programs.loaded(), 1000 * (monotonicTime() - shader_start));
+    g_prey.scaleXY(SCREEN_WIDTH_GL * (7.0 / SCREEN_WIDTH_DEG));
+    g_prey.centerXY(SCREEN_EDGE_GL, -0.02);
+    layoutSwarm(200, SCREEN_WIDTH_GL * (3.0 / SCREEN_WIDTH_DEG), 60, 1);
+    
+    const BenchScene scenes[] = {
+        {"drawOpenLoopOMR", &drawBenchOMRForward, &benchStepOMR},
+        {"drawOpenLoopPrey", &drawOpenLoopPrey, &benchStepPrey},
+        {"drawClosedLoopOMR", &drawClosedLoopOMR, &benchStepOMR},
+        {"drawGratingSweep", &drawGratingSweep, &benchStepGrating},
+        {"drawPreySwarm", &drawPreySwarm, &benchStepSwarm}
+    };
+    const double dt = 1.0 / 60;
+    const int n = g_packer.subframes();
+    const int num_pixels = context.width() * context.height();
+    std::vector<uint8_t> pixels(4 * num_pixels), planes(n * num_pixels);
+    bool packing_ok = true;
+    for (unsigned int i = 0; i < sizeof(scenes) / sizeof(scenes[0]); ++i) {
+        double start = monotonicTime();
+        for (int f = 0; f < frames; ++f) {
+            for (int k = 0; k < n; ++k) {
+                g_packer.beginSubframe(k);
+                g_warp.begin();
+                glClear(GL_COLOR_BUFFER_BIT|GL_DEPTH_BUFFER_BIT);
+                scenes[i].draw();
+                g_renderer.flush();
+                g_warp.end();
+                if (n > 1 && f == frames - 1) {
+                    // what each subframe should unpack to, to check the output
+                    readFramebuffer(g_packer.framebuffer(), context.width(),
+                                    context.height(), pixels);
+                    for (int p = 0; p < num_pixels; ++p) {
+                        planes[k * num_pixels + p] = BitPlanePacker::quantize(&pixels[4 * p], n);
+                    }
+                }
+                g_packer.endSubframe(k);
+                scenes[i].step(dt / n);
+            }
+        }
+        glFinish();
+        double elapsed = monotonicTime() - start;
+        printf("%-18s %d frames in %.3f s, %8.1f fps, checksum %016llx\n",
+               scenes[i].name, frames, elapsed, frames / elapsed, context.checksum());
+        
+        if (n > 1) {
+            readFramebuffer(context.framebuffer(), context.width(), context.height(), pixels);
+            int differ = 0;
+            for (int k = 0; k < n; ++k) {
+                for (int p = 0; p < num_pixels; ++p) {
+                    if (BitPlanePacker::unpack(&pixels[4 * p], n, k) != planes[k * num_pixels + p]) {
+                        differ++;
+                    }
+                }
+            }
+            printf("%-18s unpacked %d subframes, %d pixels differ\n", "", n, differ);
+            packing_ok = packing_ok && (differ == 0);
+        }
+        
+        if (fileid) {
+            char path[100];
+            snprintf(path, sizeof(path), "%s_%s.ppm", fileid, scenes[i].name);
+            context.savePPM(path);
+        }
+    }
+    
+    bool renderer_ok = checkRenderer(context, pixels);
+    bool decoder_ok = checkDecoder();
+    
+    GLenum gl_err = glGetError();
+    if (gl_err != GL_NO_ERROR) {
+        printf("GL error %d\n", gl_err);
+        return EXIT_FAILURE;
+    }
+    return (packing_ok && renderer_ok && decoder_ok) ? 0 : EXIT_FAILURE;
+}
+
+static void usage(const char* prog) {
+    fprintf(stderr,
+            "usage: %s [options] experiment_type file_id\n"
+            "  experiment_type 0 open-loop OMR, 1 open-loop prey, 2 closed-loop OMR,\n"
+            "                  4 open-loop grating spatial-frequency sweep,\n"
+            "                  5 open-loop prey swarm\n"
+            "  -c port   closed-loop port (default /dev/ttyACM1)\n"
+            "  -s port   synchronization port (default /dev/ttyACM0)\n"
+            "  -p file   run the design in a protocol file instead of the\n"
+            "            experiment's built-in one (the closed-loop phase for 2)\n"
+            "  -r seed   order the trials with this seed instead of one from\n"
+            "            the clock, to repeat an earlier session's protocol\n"
+            "  -w        project onto the screen with a per-pixel warp pass\n"
+            "  -b n      pack n subframes (3 or 24) into the color or bit planes\n"
+            "            of each frame, for DLP projectors in structured-light mode\n"
+            "  -m n      split the stimulus across the first n monitors, each\n"
+            "            with its own warp. the monitors should be frame-locked\n"
+            "  -H frames render each stimulus offscreen, no display or serial\n"
+            "            ports, and report fps and pixel checksums. the last\n"
+            "            frames are saved as <file_id>_<scene>.ppm if file_id is given\n",
+            prog);
+    exit(EXIT_FAILURE);
+}
+
 int main(int argc, char** argv) {
     
+    // command line
+    const char* chan_port = "/dev/ttyACM1";
+    const char* sync_port = "/dev/ttyACM0";
+    const char* protocol_path = NULL;
+    const char* seed = NULL;
+    int headless_frames = 0;
+    int opt;
+    while ((opt = getopt(argc, argv, "c:s:p:r:wb:m:H:h")) != -1) {
+        switch (opt) {
+            case 'c':
+                chan_port = optarg;
+                break;
+            case 's':
+                sync_port = optarg;
+                break;
+            case 'p':
+                protocol_path = optarg;
+                break;
+            case 'r':
+                seed = optarg;
+                break;
+            case 'w':
+                g_warp_requested = true;
+                break;
+            case 'b':
+                g_subframes_requested = atoi(optarg);
+                break;
+            case 'm':
+                g_outputs_requested = atoi(optarg);
+                break;
+            case 'H':
+                headless_frames = atoi(optarg);
+                break;
+            default:
+                usage(argv[0]);
+        }
+    }
+    if (headless_frames > 0) {
+        return runHeadless(headless_frames, (optind < argc) ? argv[optind] : NULL);
+    }
+    if (argc - optind < 2) {
+        usage(argv[0]);
+    }
+    if (g_outputs_requested > 1 && (g_warp_requested || g_subframes_requested > 1)) {
+        fprintf(stderr, "-m can't be combined with -w or -b\n");
+        exit(EXIT_FAILURE);
+    }
+    int exp_type = atoi(argv[optind]);
+    bool closed_loop = (exp_type == CLOSED_LOOP_OMR || exp_type == CLOSED_LOOP_PREY);
+    char* fileid = argv[optind + 1];
+    
+    // the design is read and checked before any hardware is touched
+    ProtocolDesign design;
+    if (protocol_path) {
+        if (!Protocol::load(protocol_path, &design)) {
+            exit(EXIT_FAILURE);
+        }
+        if (design.stimulus != exp_type) {
+            fprintf(stderr, "%s is a protocol for experiment type %d, not %d\n",
+                    protocol_path, design.stimulus, exp_type);
+            exit(EXIT_FAILURE);
+        }
+        printf("protocol %s from %s, %.0f trials\n", design.name, protocol_path,
+               Protocol::trials(design));
+    } else if (!Protocol::builtin(exp_type, &design)) {
+        printf("Unrecognized experiment type!\n");
+        exit(EXIT_FAILURE);
+    }
+    
+    // every session's trial order can be regenerated from one seed
+    if (seed) {
+        design.seed = strtoull(seed, NULL, 0);
+        design.seeded = true;
+    } else if (!design.seeded) {
+        design.seed = Random::clockSeed();
+        design.seeded = true;
+    }
+    
+    // serial set up
+    g_chan.setPort(chan_port);
+    g_chan.open();
+    g_sync_chan.setPort(sync_port);
+    g_sync_chan.open();
+    
     // GLFW set up
     GLFWwindow* window;
     glfwSetErrorCallback(error_callback);
@@ -949,80 +1510,171 @@ int main(int argc, char** argv) {
         fprintf(stderr, "Error: %s\n", glewGetErrorString(err));
     }
     
+    glfwSwapInterval(1);
+    g_frame_timer.init(mode->refreshRate);
+    g_vsync.init(mode->refreshRate);
+    GLXDrawable drawable = glfwGetGLXWindow(window);
+    if (!g_vsync.initOML(glfwGetX11Display(), drawable ? drawable : glfwGetX11Window(window))) {
+        printf("GLX_OML_sync_control not available, estimating vsync from swaps\n");
+    }
+    
     glfwSetKeyCallback(window, key_callback);
     glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_HIDDEN);
     
     glEnable(GL_DEPTH_TEST);
     glEnable(GL_CULL_FACE);
     
+    double shader_start = monotonicTime();
+    g_programs.init("./shader_cache");
+    int width, height;
+    glfwGetFramebufferSize(window, &width, &height);
+    if (g_outputs_requested > 1) {
+        if (!g_displays.init(window, g_outputs_requested,
+                             g_programs.program("./warp.vert", "./warp.frag"),
+                             SCREEN_WIDTH_GL / 2, g_vsync.period())) {
+            glfwTerminate();
+            exit(EXIT_FAILURE);
+        }
+        for (int i = 1; i < g_displays.outputs(); ++i) {
+            glfwSetKeyCallback(g_displays.window(i), key_callback);
+            glfwSetInputMode(g_displays.window(i), GLFW_CURSOR, GLFW_CURSOR_HIDDEN);
+        }
+    }
+    if (g_warp_requested) {
+        g_warp.init(g_programs.program("./warp.vert", "./warp.frag"),
+                    width, height, SCREEN_WIDTH_GL / 2);
+    }
+    if (g_subframes_requested > 1) {
+        g_packer.init(g_programs.program("./warp.vert", "./bitplane.frag"),
+                      width, height, g_subframes_requested);
+        g_warp.setOutput(g_packer.framebuffer());
+    }
+    
     // start an experiment
-    int exp_type = atoi(argv[1]);
-    setupExperiment(exp_type, argv[2]);
+    g_renderer.init();
+    setupExperiment(exp_type, fileid, design);
+    g_renderer.upload();
+    g_programs.releaseShaders();
+    printf("shader programs: %d compiled, %d from cache in %.1f ms\n",
+           g_programs.compiled(), g_programs.loaded(), 1000 * (monotonicTime() - shader_start));
     
-    double prev_sec = glfwGetTime();
-    double curr_sec;
+    // start serving the sync port, and draining the closed-loop port
+    // if anything will read it. open-loop stimuli never pop the ring,
+    // so it would only overflow
+    if (closed_loop) {
+        g_reader.start();
+    }
+    g_pulser.start();
+    
+    g_present_time = g_vsync.predict();
+    g_timeline.start(g_present_time);
     
     // first game-loop in open-loop
-    while (g_not_done && !glfwWindowShouldClose(window)) {
+    while (g_not_done && !glfwWindowShouldClose(window) && !g_displays.shouldClose()) {
         // game loop
-        curr_sec = glfwGetTime();
-        g_dt = curr_sec - prev_sec;
-        prev_sec = curr_sec;
-        g_total_elasped += g_dt;
+        renderFrame(&updateTimeline);
         
-        glClear(GL_COLOR_BUFFER_BIT|GL_DEPTH_BUFFER_BIT);
-        
-        g_drawFunc();
-        
-        if (g_total_elasped > 10) {
-            g_updateFunc();
-        }
-        
-        glfwSwapBuffers(window);
+        presentFrame(window);
+        g_vsync.swapped();
+        g_frame_timer.swapped(trialForFrame());
         glfwPollEvents();
     }
     
     printf("done with open-loop\n");
     
     // second game loop in closed-loop
-    if (exp_type == CLOSED_LOOP_OMR || exp_type == CLOSED_LOOP_PREY) {
+    if (closed_loop) {
         
         // set up closed-loop
-        prepareForClosedLoop(argv[2], true);
-        g_chan.flush();
-        if (g_serial_up) {
-            g_sync_chan.write(&g_msg, 1);
-            g_serial_up = false;
-        }
+        prepareForClosedLoop(fileid, true);
+        openClosedLoopRecord(fileid);
+        g_reader.flush();
+        setSync(false);
         g_not_done = true;
         g_total_elasped = 0;
-        g_updateFunc = &updateClosedLoopStepOMR;
+        g_handlers.start = NULL;
+        g_handlers.update = &updateClosedLoopStepOMR;
+        g_handlers.stop = &stopClosedLoopStepOMR;
+        g_handlers.between = &betweenClosedLoopStepOMR;
         g_drawFunc = &drawClosedLoopOMR;
-        g_trial_duration = 30;
-        
-        while (g_not_done && !glfwWindowShouldClose(window)) {
-            // game loop
-            curr_sec = glfwGetTime();
-            g_dt = curr_sec - prev_sec;
-            prev_sec = curr_sec;
-            g_total_elasped += g_dt;
         
-            glClear(GL_COLOR_BUFFER_BIT|GL_DEPTH_BUFFER_BIT);
+        // the first closed-loop trial starts with the next frame. the
+        // clock and frame timer restart too, so neither g_dt nor the
+        // first swap interval spans the calibration and the files
+        // written above
+        startProtocol(g_protocol, 0);
+        g_present_time = g_vsync.predict();
+        g_timeline.start(g_present_time);
+        g_frame_timer.resume();
         
-            g_drawFunc();
-            g_updateFunc();
+        while (g_not_done && !glfwWindowShouldClose(window) && !g_displays.shouldClose()) {
+            // game loop
+            renderFrame(&updateTimeline);
         
-            glfwSwapBuffers(window);
+            presentFrame(window);
+            g_vsync.swapped();
+            g_frame_timer.swapped(trialForFrame());
+            
+            // this frame shows the stimulus from this iteration's update
+            if (g_stim_sample_time > 0) {
+                g_input_latency.add(g_stim_update_time - g_stim_sample_time);
+                g_total_latency.add(monotonicTime() - g_stim_sample_time);
+            }
+            
             glfwPollEvents();
         }
     }
     
-    printf("saving velocity...\n");
-    saveVelocity(argv[2]);
+    printf("saving closed-loop data...\n");
+    if (g_closed_loop_record.isOpen() && !g_closed_loop_record.close()) {
+        printf("WARNING: closed-loop recording is incomplete\n");
+    }
+    
+    char frames_path[100];
+    strcpy(frames_path, fileid);
+    strcat(frames_path, "_frames.vrec");
+    if (!g_frame_timer.save(frames_path)) {
+        printf("WARNING: %s was not saved completely\n", frames_path);
+    }
+    printf("%llu frames, %d missed vsyncs during trials\n",
+           g_frame_timer.frames(), g_frame_timer.missed());
+    if (g_lost_trials > 0) {
+        printf("%d trials were never shown\n", g_lost_trials);
+    }
+    if (g_displays.enabled()) {
+        printf("%llu of %llu frames not presented together on all %d outputs\n",
+               g_displays.incoherent(), g_displays.frames(), g_displays.outputs());
+    }
     printf("we're done here!\n");
     
+    g_reader.stop();
+    setSync(false);
+    g_pulser.stop();
+    char sync_path[100];
+    strcpy(sync_path, fileid);
+    strcat(sync_path, "_sync.vrec");
+    if (!g_pulser.save(sync_path)) {
+        printf("WARNING: %s was not saved completely\n", sync_path);
+    }
+    printf("sync pulses: %lu, %lu failed writes, %lu dropped, slowest %.1f ms\n",
+           (unsigned long)g_pulser.pulses().size(), g_pulser.failed(), g_pulser.dropped(),
+           1000 * g_pulser.worstWrite());
+    if (closed_loop) {
+        if (g_reader.overruns() > 0) {
+            printf("serial reader dropped %lu samples\n", g_reader.overruns());
+        }
+        if (g_reader.stampOverruns() > 0) {
+            printf("serial reader lost the arrival time of %lu blocks, latency is underestimated\n",
+                   g_reader.stampOverruns());
+        }
+        const FrameDecoder& decoder = g_reader.decoder();
+        printf("serial frames: %lu decoded, %lu malformed, %lu bytes discarded\n",
+               decoder.frames(), decoder.malformed(), decoder.discarded());
+    }
+    
     g_chan.close();
     g_sync_chan.close();
+    g_displays.destroy();
     glfwDestroyWindow(window);
     glfwTerminate();
     return 0;
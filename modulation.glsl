@@ -0,0 +1,26 @@
+// prepended to every vertex shader after its #version line, see
+// shaderSource() in load_shader.cpp. the block layouts must match the
+// std140 packing in Renderer::flush()
+
+// one transform per object, filled by the Renderer
+layout(std140) uniform Transforms {
+    mat4 transforms[256];
+};
+
+// per-object appearance, filled by the Renderer: rgb is scaled by
+// contrast around the object's mean color, then by tint * luminance
+struct Modulation {
+    vec4 gain;   // tint * luminance, alpha multiplier in w
+    vec4 mean;   // mean color of the object, contrast in w
+};
+layout(std140) uniform Modulations {
+    Modulation modulations[256];
+};
+
+vec4 modulate(vec4 c, uint object)
+{
+    Modulation m = modulations[object];
+    c.rgb = m.gain.rgb * (m.mean.rgb + m.mean.w * (c.rgb - m.mean.rgb));
+    c.a *= m.gain.a;
+    return c;
+}
@@ -0,0 +1,42 @@
+#version 410
+#define PI 3.14159265359
+#define WAVEFORM_SQUARE 0
+#define WAVEFORM_SINE 1
+
+in vec2 screen;
+flat in float edge;
+flat in vec4 color;
+out vec4 fcolor;
+
+uniform float width_deg;   // visual angle spanned by the screen
+uniform float frequency;   // cycles / deg
+uniform float duty_cycle;  // bright fraction of a square-wave period
+uniform int waveform;
+uniform float contrast;    // Michelson contrast around color / 2
+uniform float phase;       // cycles
+uniform float orientation; // radians, 0 is vertical bars
+uniform int cylinder;      // 0 when a warp pass does the projection
+
+void main()
+{
+    // undo the cylinder projection of rotating_grating.vert, so the
+    // pattern is evaluated in degrees of visual angle
+    float frac;
+    if (cylinder != 0)
+        frac = acos(clamp(-screen.x / edge, -1.0, 1.0)) / PI;
+    else
+        frac = 0.5 * (screen.x / edge + 1);
+    vec2 deg = vec2(width_deg * (frac - 0.5),
+                    width_deg * screen.y / (2 * edge));
+    
+    vec2 dir = vec2(cos(orientation), sin(orientation));
+    float s = fract(frequency * dot(deg, dir) - phase);
+    
+    float w;
+    if (waveform == WAVEFORM_SQUARE)
+        w = (s < duty_cycle) ? 1 : -1;
+    else
+        w = cos(2 * PI * s);
+    
+    fcolor = vec4(color.rgb * (0.5 + 0.5 * contrast * w), 1);
+}
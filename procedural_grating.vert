@@ -0,0 +1,21 @@
+#version 410
+
+layout(location = 0) in vec2 vPosition;
+layout(location = 1) in vec4 vColor;
+layout(location = 2) in uint vObject;
+
+// transforms[] and modulate() come from modulation.glsl
+out vec2 screen;
+flat out float edge;
+flat out vec4 color;
+
+void main()
+{
+    mat4 transform_matrix = transforms[vObject];
+    vec4 p = transform_matrix * vec4(vPosition, 0, 1);
+    
+    screen = p.xy;
+    edge = transform_matrix[0][0];
+    color = modulate(vColor / 255, vObject);
+    gl_Position = p;
+}
@@ -3,13 +3,14 @@
 
 layout(location = 0) in vec2 vPosition;
 layout(location = 1) in vec4 vColor;
+layout(location = 2) in uint vObject;
 
-uniform mat4 transform_matrix;
-
+// transforms[] and modulate() come from modulation.glsl
 flat out vec4 color;
 
 void main()
 {
+    mat4 transform_matrix = transforms[vObject];
     vec4 p = transform_matrix * vec4(vPosition, 0, 1);
     
     float r = transform_matrix[0][0];
@@ -17,7 +18,7 @@ void main()
     {
         float frac = (p.x + r) / (2 * r);
         p.x = r * cos(-PI * (1 + frac));
-        color = vColor / 255;
+        color = modulate(vColor / 255, vObject);
     }
     else
     {
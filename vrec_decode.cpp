@@ -0,0 +1,162 @@
+/* Expands the compressed channels of a .vrec recording.
+
+   $ ./vrec_decode fish01_closed_loop.vrec fish01_closed_loop_raw.vrec
+
+ Every chunk of a "rice" channel is decoded and the file is written
+ back out with all channels raw, so it can be memory-mapped by
+ load_vrec.py. Compression ratio and decode speed are reported per
+ channel.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <vector>
+#include <sstream>
+#include <stdint.h>
+#include "RiceCodec.h"
+
+typedef struct ChannelInfo {
+    std::string name;
+    bool compressed;
+    unsigned long long raw_bytes;
+    unsigned long long stored_bytes;
+} ChannelInfo;
+
+static double now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + 1e-9 * ts.tv_nsec;
+}
+
+static bool readExactly(FILE* file, void* data, size_t n) {
+    return fread(data, 1, n, file) == n;
+}
+
+int main(int argc, char** argv) {
+    if (argc != 3) {
+        fprintf(stderr, "usage: %s in.vrec out.vrec\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+
+    FILE* in = fopen(argv[1], "rb");
+    if (!in) {
+        perror(argv[1]);
+        exit(EXIT_FAILURE);
+    }
+
+    char magic[4];
+    uint32_t version, header_bytes;
+    if (!readExactly(in, magic, 4) || memcmp(magic, "VREC", 4) != 0 ||
+        !readExactly(in, &version, 4) || !readExactly(in, &header_bytes, 4)) {
+        fprintf(stderr, "%s is not a .vrec file\n", argv[1]);
+        exit(EXIT_FAILURE);
+    }
+    std::string header(header_bytes, ' ');
+    if (!readExactly(in, &header[0], header_bytes)) {
+        fprintf(stderr, "%s: truncated header\n", argv[1]);
+        exit(EXIT_FAILURE);
+    }
+
+    // rewrite channel declarations as raw
+    std::vector<ChannelInfo> channels;
+    std::string out_header;
+    std::istringstream lines(header);
+    std::string line;
+    while (std::getline(lines, line)) {
+        std::istringstream words(line);
+        std::string kind;
+        words >> kind;
+        if (kind == "channel") {
+            unsigned int id;
+            std::string name, dtype, rate, codec = "raw";
+            words >> id >> name >> dtype >> rate >> codec;
+            if (id >= channels.size()) {
+                channels.resize(id + 1);
+            }
+            channels[id].name = name;
+            channels[id].compressed = (codec == "rice");
+            channels[id].raw_bytes = 0;
+            channels[id].stored_bytes = 0;
+            out_header += "channel " + std::to_string(id) + " " + name + " " +
+                          dtype + " " + rate + " raw\n";
+        } else if (kind == "param") {
+            out_header += line + "\n";
+        }
+    }
+    while (out_header.size() % 8) {
+        out_header += " ";
+    }
+
+    FILE* out = fopen(argv[2], "wb");
+    if (!out) {
+        perror(argv[2]);
+        exit(EXIT_FAILURE);
+    }
+    uint32_t out_version = 2;
+    uint32_t out_header_bytes = out_header.size();
+    fwrite("VREC", 1, 4, out);
+    fwrite(&out_version, 4, 1, out);
+    fwrite(&out_header_bytes, 4, 1, out);
+    fwrite(out_header.data(), 1, out_header.size(), out);
+
+    std::vector<uint8_t> payload, decoded;
+    double decode_time = 0;
+    unsigned long long decoded_bytes = 0;
+    static const uint8_t zeros[8] = {0};
+
+    char tag[4];
+    uint32_t head[3];
+    while (readExactly(in, tag, 4)) {
+        if (memcmp(tag, "CHNK", 4) != 0 || !readExactly(in, head, sizeof(head))) {
+            fprintf(stderr, "%s: bad chunk, stopping\n", argv[1]);
+            break;
+        }
+        uint32_t channel = head[0], count = head[1], bytes = head[2];
+        payload.resize(bytes);
+        if (!readExactly(in, payload.data(), bytes) || channel >= channels.size()) {
+            fprintf(stderr, "%s: truncated chunk, stopping\n", argv[1]);
+            break;
+        }
+        fseek(in, (8 - bytes % 8) % 8, SEEK_CUR);
+
+        ChannelInfo& c = channels[channel];
+        c.stored_bytes += bytes;
+        const uint8_t* data = payload.data();
+        if (c.compressed) {
+            decoded.resize(count);
+            double t0 = now();
+            if (riceDecode(payload.data(), bytes, decoded.data(), count) == 0 && count > 0) {
+                fprintf(stderr, "%s: corrupt %s chunk, stopping\n", argv[1], c.name.c_str());
+                break;
+            }
+            decode_time += now() - t0;
+            decoded_bytes += count;
+            data = decoded.data();
+            bytes = count;
+        }
+        c.raw_bytes += bytes;
+
+        uint32_t out_head[3] = {channel, count, bytes};
+        fwrite("CHNK", 1, 4, out);
+        fwrite(out_head, 4, 3, out);
+        fwrite(data, 1, bytes, out);
+        fwrite(zeros, 1, (8 - bytes % 8) % 8, out);
+    }
+    fclose(in);
+    fclose(out);
+
+    for (unsigned int i = 0; i < channels.size(); ++i) {
+        ChannelInfo& c = channels[i];
+        if (c.compressed && c.stored_bytes > 0) {
+            printf("%s: %llu bytes from %llu (%.2fx)\n", c.name.c_str(),
+                   c.raw_bytes, c.stored_bytes, (double)c.raw_bytes / c.stored_bytes);
+        }
+    }
+    if (decode_time > 0) {
+        printf("decoded at %.1f MB/s\n", decoded_bytes / decode_time / 1e6);
+    }
+    return 0;
+}
@@ -0,0 +1,15 @@
+#version 410
+
+uniform sampler2D scene; // stimulus rendered in flat visual-angle space
+uniform sampler2D lut;   // per screen pixel, where to sample the scene
+
+out vec4 fcolor;
+
+void main()
+{
+    vec2 uv = texelFetch(lut, ivec2(gl_FragCoord.xy), 0).rg;
+    if (uv.x < 0)
+        fcolor = vec4(0, 0, 0, 1); // not on the projection surface
+    else
+        fcolor = texture(scene, uv);
+}